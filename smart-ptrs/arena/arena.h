@@ -0,0 +1,151 @@
+#pragma once
+
+#include <weak/shared.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Group ownership: all objects of a SharedArena share one reference count.
+//
+//     SharedArena arena;
+//     SharedPtr<Request> request = arena.Make<Request>();
+//     request->headers = arena.Make<Headers>().Get();
+//
+// Make<T> places the object in the arena (bump allocation from chunks) and returns an
+// aliasing SharedPtr that holds the whole arena: the memory goes away when the last
+// pointer to any of its objects (and the SharedArena itself) is gone. Then the
+// destructors run in reverse order of construction and all chunks are freed at once.
+// Trivially destructible objects are not recorded at all.
+//
+// Pointers may be copied from any threads; Make is not thread-safe. Objects link to
+// each other by raw pointers: a SharedPtr into its own arena would keep it alive forever.
+class SharedArena {
+public:
+    static constexpr size_t kDefaultChunkSize = 4096;
+    static constexpr size_t kMaxChunkSize = size_t{1} << 20;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    // The first chunk is allocated with the arena; later chunks double up to kMaxChunkSize.
+    explicit SharedArena(size_t chunk_size = kDefaultChunkSize)
+        : state_(MakeShared<State>(chunk_size)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    template <typename T, typename... Args>
+    SharedPtr<T> Make(Args&&... args) {
+        State& state = *state_;
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            void* memory = state.Allocate(sizeof(T), alignof(T));
+            return SharedPtr<T>(state_, new (memory) T(std::forward<Args>(args)...));
+        } else {
+            // The destructor record goes right before the object.
+            constexpr size_t kAlignment = std::max(alignof(T), alignof(Destructor));
+            constexpr size_t kOffset =
+                (sizeof(Destructor) + alignof(T) - 1) / alignof(T) * alignof(T);
+            char* memory = static_cast<char*>(state.Allocate(kOffset + sizeof(T), kAlignment));
+            T* object = new (memory + kOffset) T(std::forward<Args>(args)...);
+            state.destructors = new (memory) Destructor{state.destructors, object, &Destroy<T>};
+            ++state.num_destructors;
+            return SharedPtr<T>(state_, object);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Handles and object pointers holding the arena.
+    size_t UseCount() const {
+        return state_.UseCount();
+    }
+    // Objects with a recorded destructor.
+    size_t NumDestructors() const {
+        return state_->num_destructors;
+    }
+    size_t NumChunks() const {
+        return state_->num_chunks;
+    }
+    size_t AllocatedBytes() const {
+        return state_->allocated_bytes;
+    }
+
+private:
+    struct Destructor {
+        Destructor* prev;
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    struct Chunk {
+        Chunk* prev;
+    };
+
+    struct State {
+        explicit State(size_t chunk_size) : next_chunk_size(chunk_size) {
+            NewChunk(0, 1);
+        }
+
+        State(const State& other) = delete;
+        State& operator=(const State& other) = delete;
+
+        ~State() {
+            for (Destructor* record = destructors; record; record = record->prev) {
+                record->destroy(record->object);
+            }
+            while (chunks) {
+                ::operator delete(std::exchange(chunks, chunks->prev));
+            }
+        }
+
+        void* Allocate(size_t size, size_t alignment) {
+            auto address = reinterpret_cast<uintptr_t>(current);
+            uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+            if (aligned + size > reinterpret_cast<uintptr_t>(end)) {
+                NewChunk(size, alignment);
+                address = reinterpret_cast<uintptr_t>(current);
+                aligned = (address + alignment - 1) & ~(alignment - 1);
+            }
+            current = reinterpret_cast<char*>(aligned + size);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        // A chunk big enough for `size` bytes aligned to `alignment`.
+        void NewChunk(size_t size, size_t alignment) {
+            size_t header = (sizeof(Chunk) + alignof(std::max_align_t) - 1) /
+                            alignof(std::max_align_t) * alignof(std::max_align_t);
+            size_t chunk_size = std::max(next_chunk_size, header + size + alignment - 1);
+            next_chunk_size = std::min(next_chunk_size * 2, kMaxChunkSize);
+
+            auto chunk = static_cast<Chunk*>(::operator new(chunk_size));
+            chunk->prev = chunks;
+            chunks = chunk;
+            current = reinterpret_cast<char*>(chunk) + header;
+            end = reinterpret_cast<char*>(chunk) + chunk_size;
+            ++num_chunks;
+            allocated_bytes += chunk_size;
+        }
+
+        Chunk* chunks = nullptr;
+        char* current = nullptr;
+        char* end = nullptr;
+        size_t next_chunk_size;
+        Destructor* destructors = nullptr;
+        size_t num_destructors = 0;
+        size_t num_chunks = 0;
+        size_t allocated_bytes = 0;
+    };
+
+    template <typename T>
+    static void Destroy(void* object) {
+        static_cast<T*>(object)->~T();
+    }
+
+    SharedPtr<State> state_;
+};
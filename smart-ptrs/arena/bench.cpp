@@ -0,0 +1,71 @@
+#include "arena.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A parsed request with a few hundred small sub-objects: one MakeShared per object
+// against one SharedArena for the whole request. Run with `test_arena [bench]`.
+
+namespace {
+
+struct Field {
+    int key = 0;
+    int value = 0;
+};
+
+struct Node {
+    std::string name;
+    std::vector<SharedPtr<Field>> fields;
+};
+
+constexpr int kRequests = 20000;
+constexpr int kNodes = 32;
+constexpr int kFields = 8;
+
+template <typename Make>
+double Krequests(Make make) {
+    auto begin = std::chrono::steady_clock::now();
+    int64_t sum = 0;
+    for (int i = 0; i < kRequests; ++i) {
+        std::vector<SharedPtr<Node>> nodes = make();
+        sum += nodes.back()->fields.back()->value;
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    REQUIRE(sum == kRequests * (kFields - 1));
+    return kRequests / seconds / 1e3;
+}
+
+}  // namespace
+
+TEST_CASE("Request-scoped objects", "[.bench]") {
+    double shared = Krequests([] {
+        std::vector<SharedPtr<Node>> nodes;
+        for (int i = 0; i < kNodes; ++i) {
+            auto node = MakeShared<Node>();
+            for (int j = 0; j < kFields; ++j) {
+                node->fields.push_back(MakeShared<Field>(Field{i, j}));
+            }
+            nodes.push_back(node);
+        }
+        return nodes;
+    });
+    double arena = Krequests([] {
+        SharedArena arena;
+        std::vector<SharedPtr<Node>> nodes;
+        for (int i = 0; i < kNodes; ++i) {
+            auto node = arena.Make<Node>();
+            for (int j = 0; j < kFields; ++j) {
+                node->fields.push_back(arena.Make<Field>(Field{i, j}));
+            }
+            nodes.push_back(node);
+        }
+        return nodes;
+    });
+    std::cout << "MakeShared " << shared << " Krequests/s\tSharedArena " << arena
+              << " Krequests/s\n";
+}
@@ -0,0 +1,127 @@
+#include "arena.h"
+#include "allocations_checker.h"
+
+#include <weak/weak.h>
+
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Logged {
+    Logged(std::vector<int>* log, int id) : log(log), id(id) {
+    }
+    ~Logged() {
+        log->push_back(id);
+    }
+
+    std::vector<int>* log;
+    int id;
+};
+
+struct Headers {
+    std::vector<std::string> lines;
+};
+
+struct Request {
+    std::string path;
+    Headers* headers = nullptr;
+};
+
+}  // namespace
+
+TEST_CASE("Pointers keep the arena") {
+    SharedPtr<Request> request;
+    WeakPtr<Request> weak;
+    {
+        SharedArena arena;
+        request = arena.Make<Request>();
+        request->path = "/index.html";
+        auto headers = arena.Make<Headers>();
+        request->headers = headers.Get();
+        request->headers->lines.push_back("Host: example.com");
+        weak = request;
+        REQUIRE(arena.UseCount() == 3);
+    }
+    REQUIRE(request.UseCount() == 1);
+    REQUIRE(request->headers->lines.size() == 1);
+
+    // Pointers to any object of the arena alias the same block.
+    SharedPtr<Headers> headers(request, request->headers);
+    request.Reset();
+    REQUIRE(!weak.Expired());
+    REQUIRE(headers->lines[0] == "Host: example.com");
+    headers.Reset();
+    REQUIRE(weak.Expired());
+}
+
+TEST_CASE("Destructors run in reverse order") {
+    std::vector<int> log;
+    {
+        SharedArena arena(64);
+        for (int i = 0; i < 100; ++i) {
+            arena.Make<Logged>(&log, i);
+            arena.Make<int>(i);
+        }
+        REQUIRE(arena.NumDestructors() == 100);
+        REQUIRE(arena.NumChunks() > 1);
+        REQUIRE(log.empty());
+    }
+    REQUIRE(log.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(log[i] == 99 - i);
+    }
+}
+
+TEST_CASE("Trivial objects") {
+    SharedArena arena;
+    size_t allocated = arena.AllocatedBytes();
+    std::vector<SharedPtr<int>> ints;
+    ints.reserve(100);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_ZERO_ALLOCATIONS(auto ptr = arena.Make<int>(i); ints.push_back(ptr));
+    }
+    REQUIRE(arena.NumDestructors() == 0);
+    REQUIRE(arena.AllocatedBytes() == allocated);
+    for (int i = 1; i < 100; ++i) {
+        REQUIRE(ints[i].Get() == ints[i - 1].Get() + 1);
+    }
+}
+
+TEST_CASE("Alignment and large objects") {
+    struct alignas(64) Wide {
+        char data[3];
+    };
+    struct Large {
+        char data[10000];
+    };
+
+    SharedArena arena(128);
+    for (int i = 0; i < 10; ++i) {
+        auto byte = arena.Make<char>('x');
+        auto wide = arena.Make<Wide>();
+        REQUIRE(reinterpret_cast<uintptr_t>(wide.Get()) % 64 == 0);
+    }
+    auto large = arena.Make<Large>();
+    large->data[9999] = 1;
+    REQUIRE(arena.AllocatedBytes() >= sizeof(Large));
+}
+
+TEST_CASE("Throwing constructor") {
+    struct Throwing {
+        Throwing() {
+            throw std::runtime_error("no");
+        }
+        ~Throwing() {
+        }
+    };
+
+    SharedArena arena;
+    REQUIRE_THROWS_AS(arena.Make<Throwing>(), std::runtime_error);
+    REQUIRE(arena.NumDestructors() == 0);
+    REQUIRE(arena.UseCount() == 1);
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "waiters.h"
+
+#include <weak/shared.h>
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <utility>
+
+// Asynchronous construction of shared objects with C++20 coroutines:
+//
+//     AsyncShared<Index> index = MakeSharedAsync<Index>(pool, "index.bin");
+//     ...
+//     SharedPtr<Index> ptr = co_await index;
+//
+// MakeSharedAsync is itself a coroutine. Its promise is the control block, so the
+// counters, the object and the arguments all live in the coroutine frame: one
+// allocation, as with MakeShared. The construction starts right away on `executor`;
+// every copy of the AsyncShared handle awaits the same construction, and the awaiting
+// coroutines are resumed (on the executor thread) once the object is built.
+//
+// Executor: anything with `Post(std::coroutine_handle<>)` that resumes the handle
+// some time later, e.g. in a thread pool.
+
+// Builds the object in the thread that calls MakeSharedAsync.
+struct InlineExecutor {
+    void Post(std::coroutine_handle<> handle) {
+        handle.resume();
+    }
+};
+
+template <typename T>
+class AsyncShared;
+
+// Promise of MakeSharedAsync and control block of its object. The running coroutine
+// holds a strong reference until it reaches the final suspend point, so the object can
+// only die after it is built. Releasing the block destroys the frame.
+template <typename T>
+struct ControlBlockAsync : ControlBlockBase {
+    template <typename Executor>
+    struct Schedule {
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle) const {
+            executor.Post(handle);
+        }
+        void await_resume() const noexcept {
+        }
+
+        Executor& executor;
+    };
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<ControlBlockAsync> handle) const noexcept {
+            auto& block = handle.promise();
+            block.waiters_.Close();
+            // May destroy the frame: the coroutine is already suspended.
+            block.DecStrongRefCnt();
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    ControlBlockAsync() {
+        this->IncStrongRefCnt();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Promise
+
+    AsyncShared<T> get_return_object() {
+        return AsyncShared<T>(this);
+    }
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+
+    // `co_return factory;`: the object is `factory()`, built right in the frame.
+    template <typename Factory>
+    void return_value(Factory&& factory) {
+        new (&buffer) T(factory());
+        built_ = true;
+        // Binds `weak_this_` for types with EnableSharedFromThis.
+        SharedPtr<T> self(this, Object(), true);
+    }
+    void unhandled_exception() {
+        exception_ = std::current_exception();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Control block
+
+    void ReleaseObject() override {
+        if (built_) {
+            Object()->~T();
+        }
+        this->ObjectDestroyed();
+    }
+
+    void ReleaseBlock() override {
+        std::coroutine_handle<ControlBlockAsync>::from_promise(*this).destroy();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Waiting
+
+    bool IsDone() const {
+        return waiters_.IsClosed();
+    }
+
+    // Returns false if the construction is already over and `waiter` must not suspend.
+    bool AddWaiter(WaiterList::Waiter* waiter) {
+        return waiters_.Add(waiter);
+    }
+
+    void Wait() const {
+        waiters_.Wait();
+    }
+
+    SharedPtr<T> Result() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+        return SharedPtr<T>(this, Object());
+    }
+
+    T* Object() {
+        return std::launder(reinterpret_cast<T*>(&buffer));
+    }
+
+private:
+    WaiterList waiters_;
+    std::exception_ptr exception_;
+    bool built_ = false;
+    alignas(T) char buffer[sizeof(T)];
+};
+
+// Handle of an object under asynchronous construction. Copies share the construction;
+// each holds a strong reference to the block (see SharedPtr::UseCount).
+template <typename T>
+class AsyncShared {
+    friend struct ControlBlockAsync<T>;
+
+public:
+    using promise_type = ControlBlockAsync<T>;
+
+    class Awaiter : WaiterList::Waiter {
+    public:
+        explicit Awaiter(promise_type* block) : block_(block) {
+        }
+
+        bool await_ready() const {
+            return block_->IsDone();
+        }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            return block_->AddWaiter(this);
+        }
+        // Rethrows the exception of the constructor.
+        SharedPtr<T> await_resume() {
+            return block_->Result();
+        }
+
+    private:
+        promise_type* block_;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    AsyncShared() {
+    }
+
+    AsyncShared(const AsyncShared& other) : block_(other.block_) {
+        if (block_) {
+            block_->IncStrongRefCnt();
+        }
+    }
+    AsyncShared(AsyncShared&& other) : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    AsyncShared& operator=(AsyncShared other) {
+        std::swap(block_, other.block_);
+        return *this;
+    }
+
+    ~AsyncShared() {
+        if (block_) {
+            block_->DecStrongRefCnt();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // The object is built or its constructor has thrown.
+    bool IsReady() const {
+        return block_->IsDone();
+    }
+
+    // Blocks the calling thread until the construction is over.
+    SharedPtr<T> Get() const {
+        block_->Wait();
+        return block_->Result();
+    }
+
+    Awaiter operator co_await() const {
+        return Awaiter(block_);
+    }
+
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+private:
+    explicit AsyncShared(promise_type* block) : block_(block) {
+        block_->IncStrongRefCnt();
+    }
+
+    promise_type* block_ = nullptr;
+};
+
+// Builds `T(args...)` on `executor`. The arguments are copied into the frame, the
+// executor must outlive the construction.
+template <typename T, typename Executor, typename... Args>
+AsyncShared<T> MakeSharedAsync(Executor& executor, Args... args) {
+    co_await typename ControlBlockAsync<T>::template Schedule<Executor>{executor};
+    co_return [&] { return T(std::move(args)...); };
+}
@@ -0,0 +1,230 @@
+#include "async.h"
+#include "allocations_checker.h"
+
+#include <weak/weak.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Runs posted handles when asked to.
+struct ManualExecutor {
+    void Post(std::coroutine_handle<> handle) {
+        std::lock_guard guard(mutex);
+        queue.push_back(handle);
+    }
+
+    void RunAll() {
+        while (true) {
+            std::coroutine_handle<> handle;
+            {
+                std::lock_guard guard(mutex);
+                if (queue.empty()) {
+                    return;
+                }
+                handle = queue.front();
+                queue.pop_front();
+            }
+            handle.resume();
+        }
+    }
+
+    std::mutex mutex;
+    std::deque<std::coroutine_handle<>> queue;
+};
+
+// Each handle is resumed in a new thread.
+struct ThreadExecutor {
+    void Post(std::coroutine_handle<> handle) {
+        threads.emplace_back([handle] { handle.resume(); });
+    }
+
+    ~ThreadExecutor() {
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    std::vector<std::thread> threads;
+};
+
+// Fire-and-forget coroutine for the tests.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+Detached Await(AsyncShared<std::string> async, SharedPtr<std::string>* result) {
+    *result = co_await async;
+}
+
+struct Throwing {
+    explicit Throwing(int) {
+        throw std::runtime_error("load failed");
+    }
+};
+
+Detached AwaitError(AsyncShared<Throwing> async, std::string* message) {
+    try {
+        co_await async;
+    } catch (const std::exception& error) {
+        *message = error.what();
+    }
+}
+
+struct Index {
+    explicit Index(int size) : size(size) {
+        ++built;
+    }
+    ~Index() {
+        ++destroyed;
+    }
+
+    int size;
+
+    static inline std::atomic<int> built = 0;
+    static inline std::atomic<int> destroyed = 0;
+};
+
+struct Self : EnableSharedFromThis<Self> {
+    explicit Self(int value) : value(value) {
+    }
+
+    int value;
+};
+
+}  // namespace
+
+TEST_CASE("MakeSharedAsync inline") {
+    InlineExecutor executor;
+    auto async = MakeSharedAsync<std::string>(executor, 3, 'x');
+    REQUIRE(async.IsReady());
+    auto ptr = async.Get();
+    REQUIRE(*ptr == "xxx");
+}
+
+TEST_CASE("MakeSharedAsync single allocation") {
+    InlineExecutor executor;
+    EXPECT_ONE_ALLOCATION(auto ptr = MakeSharedAsync<int>(executor, 42).Get();
+                          REQUIRE(*ptr == 42));
+}
+
+TEST_CASE("Awaiters share one construction") {
+    Index::built = 0;
+    Index::destroyed = 0;
+    ManualExecutor executor;
+    {
+        auto async = MakeSharedAsync<std::string>(executor, "built");
+        std::vector<SharedPtr<std::string>> results(3);
+        for (auto& result : results) {
+            Await(async, &result);
+        }
+        REQUIRE(!async.IsReady());
+        REQUIRE(!results[0]);
+
+        executor.RunAll();
+        REQUIRE(async.IsReady());
+        for (auto& result : results) {
+            REQUIRE(*result == "built");
+            REQUIRE(result.Get() == results[0].Get());
+        }
+
+        // Already built: no suspension.
+        SharedPtr<std::string> late;
+        Await(async, &late);
+        REQUIRE(late.Get() == results[0].Get());
+    }
+
+    {
+        auto async = MakeSharedAsync<Index>(executor, 10);
+        auto copy = async;
+        executor.RunAll();
+        REQUIRE(copy.Get()->size == 10);
+    }
+    REQUIRE(Index::built == 1);
+    REQUIRE(Index::destroyed == 1);
+}
+
+TEST_CASE("Object outlives the handle") {
+    Index::built = 0;
+    Index::destroyed = 0;
+    ManualExecutor executor;
+    SharedPtr<Index> ptr;
+    {
+        auto async = MakeSharedAsync<Index>(executor, 7);
+        executor.RunAll();
+        ptr = async.Get();
+    }
+    REQUIRE(ptr->size == 7);
+    WeakPtr<Index> weak(ptr);
+    ptr.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(Index::destroyed == 1);
+
+    // Handle dropped before the construction.
+    MakeSharedAsync<Index>(executor, 8);
+    executor.RunAll();
+    REQUIRE(Index::built == 2);
+    REQUIRE(Index::destroyed == 2);
+}
+
+TEST_CASE("Constructor throws") {
+    ManualExecutor executor;
+    auto async = MakeSharedAsync<Throwing>(executor, 1);
+    std::string message;
+    AwaitError(async, &message);
+    executor.RunAll();
+    REQUIRE(message == "load failed");
+    REQUIRE(async.IsReady());
+    REQUIRE_THROWS_AS(async.Get(), std::runtime_error);
+}
+
+TEST_CASE("MakeSharedAsync with EnableSharedFromThis") {
+    InlineExecutor executor;
+    auto ptr = MakeSharedAsync<Self>(executor, 5).Get();
+    auto self = ptr->SharedFromThis();
+    REQUIRE(self.Get() == ptr.Get());
+    REQUIRE(self->value == 5);
+}
+
+TEST_CASE("MakeSharedAsync on another thread") {
+    for (int round = 0; round < 100; ++round) {
+        ThreadExecutor executor;
+        auto async = MakeSharedAsync<std::string>(executor, "threaded");
+        std::vector<SharedPtr<std::string>> results(4);
+        for (auto& result : results) {
+            Await(async, &result);
+        }
+        REQUIRE(*async.Get() == "threaded");
+        executor.threads.back().join();
+        executor.threads.clear();
+        for (auto& result : results) {
+            REQUIRE(result.Get() == async.Get().Get());
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+
+// Lock-free list of coroutines waiting for a one-shot event (an object built, a task
+// finished). Nodes live in the awaiters themselves, so waiting allocates nothing.
+// Close() fires the event once: it resumes every waiter in the calling thread, and
+// waiters that come later do not suspend at all.
+class WaiterList {
+public:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        Waiter* next = nullptr;
+    };
+
+    bool IsClosed() const {
+        return head_.load(std::memory_order_acquire) == Closed();
+    }
+
+    // Returns false if the list is already closed and `waiter` must not suspend.
+    bool Add(Waiter* waiter) {
+        void* head = head_.load(std::memory_order_acquire);
+        do {
+            if (head == Closed()) {
+                return false;
+            }
+            waiter->next = static_cast<Waiter*>(head);
+        } while (!head_.compare_exchange_weak(head, waiter, std::memory_order_release,
+                                              std::memory_order_acquire));
+        return true;
+    }
+
+    // Blocks the calling thread until the list is closed.
+    void Wait() const {
+        if (IsClosed()) {
+            return;
+        }
+        // Either Wait() sees the list closed or Close() sees the flag: both are seq_cst.
+        blocked_.store(true);
+        void* head = head_.load();
+        while (head != Closed()) {
+            head_.wait(head, std::memory_order_acquire);
+            head = head_.load(std::memory_order_acquire);
+        }
+    }
+
+    void Close() {
+        void* head = head_.exchange(this);
+        // Waking is a syscall: only when a thread blocks in Wait().
+        if (blocked_.load()) {
+            head_.notify_all();
+        }
+        for (auto waiter = static_cast<Waiter*>(head); waiter;) {
+            // The resumed coroutine may destroy its awaiter.
+            auto next = waiter->next;
+            waiter->handle.resume();
+            waiter = next;
+        }
+    }
+
+private:
+    const void* Closed() const {
+        return this;
+    }
+
+    // Suspended waiters, or `this` once closed.
+    std::atomic<void*> head_ = nullptr;
+    mutable std::atomic<bool> blocked_ = false;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <intrusive/intrusive.h>
+#include <unique/unique.h>
+#include <weak/shared.h>
+
+#include <cassert>
+#include <cstddef>  // std::nullptr_t
+#include <cstdio>
+#include <cstdlib>
+
+// Non-owning view of an object owned by a SharedPtr, IntrusivePtr or UniquePtr.
+//
+// A view is created implicitly from the owner, is passed by value and never touches
+// reference counters, so it is a cheaper parameter type than `const SharedPtr<T>&`
+// (no double indirection) or a SharedPtr copy (no counter traffic). The owner has to
+// outlive the view. A view of a SharedPtr carries its control block and can be
+// promoted back with ToShared(); a view of an IntrusivePtr with ToIntrusive().
+//
+// Without SMART_PTRS_CHECK_BORROWS the view is trivially copyable. With it, a view of
+// a SharedPtr remembers the generation of the control block and holds a weak
+// reference to keep the block readable: every access checks that the object is still
+// alive, in release builds too. Views of IntrusivePtr and UniquePtr owners have no
+// control block to check.
+template <typename T>
+class BorrowedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    BorrowedPtr() {
+    }
+    BorrowedPtr(std::nullptr_t) {
+    }
+
+    template <typename Y>
+    BorrowedPtr(const SharedPtr<Y>& owner) : ptr_(owner.ptr_), block_(owner.block_) {
+#if SMART_PTRS_CHECK_BORROWS
+        Track();
+#endif
+    }
+    template <typename Y>
+    BorrowedPtr(const IntrusivePtr<Y>& owner) : ptr_(owner.Get()) {
+    }
+    template <typename Y, typename Deleter>
+    BorrowedPtr(const UniquePtr<Y, Deleter>& owner) : ptr_(owner.Get()) {
+    }
+
+#if SMART_PTRS_CHECK_BORROWS
+    BorrowedPtr(const BorrowedPtr& other)
+        : ptr_(other.ptr_), block_(other.block_), generation_(other.generation_) {
+        if (block_) {
+            block_->IncWeakRefCnt();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    BorrowedPtr& operator=(const BorrowedPtr& other) {
+        BorrowedPtr copy(other);
+        std::swap(ptr_, copy.ptr_);
+        std::swap(block_, copy.block_);
+        std::swap(generation_, copy.generation_);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~BorrowedPtr() {
+        if (block_) {
+            block_->DecWeakRefCnt();
+        }
+    }
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        Check();
+        return ptr_;
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Promotion
+
+    // Only for views of a SharedPtr (or empty views).
+    SharedPtr<T> ToShared() const {
+        Check();
+        assert(block_ || !ptr_);
+        if (!block_) {
+            return SharedPtr<T>();
+        }
+        return SharedPtr<T>(block_, ptr_);
+    }
+
+    // Requires an intrusive T (IncRef/DecRef inside the object).
+    IntrusivePtr<T> ToIntrusive() const {
+        return ptr_ ? IntrusivePtr<T>(Get()) : IntrusivePtr<T>();
+    }
+
+private:
+#if SMART_PTRS_CHECK_BORROWS
+    void Track() {
+        if (block_) {
+            generation_ = block_->generation_;
+            block_->IncWeakRefCnt();
+        }
+    }
+#endif
+
+    void Check() const {
+#if SMART_PTRS_CHECK_BORROWS
+        if (block_ && block_->generation_ != generation_) {
+            std::fputs("Borrow outlived its owner\n", stderr);
+            std::abort();
+        }
+#endif
+    }
+
+    T* ptr_ = nullptr;
+    ControlBlockBase* block_ = nullptr;
+#if SMART_PTRS_CHECK_BORROWS
+    size_t generation_ = 0;
+#endif
+};
@@ -0,0 +1,115 @@
+#include "borrowed.h"
+#include "allocations_checker.h"
+
+#include <catch.hpp>
+
+#include <string>
+#include <type_traits>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Base {
+    virtual ~Base() = default;
+    int base = 1;
+};
+
+struct Derived : Base {
+    int derived = 2;
+};
+
+struct Node : SimpleRefCounted<Node> {
+    std::string name;
+};
+
+size_t Length(BorrowedPtr<std::string> str) {
+    return str->size();
+}
+
+int BaseValue(BorrowedPtr<Base> ptr) {
+    return ptr->base;
+}
+
+}  // namespace
+
+TEST_CASE("BorrowedPtr from owners") {
+    auto shared = MakeShared<std::string>("shared");
+    UniquePtr<std::string> unique(new std::string("unique!"));
+    auto intrusive = MakeIntrusive<Node>();
+    intrusive->name = "intrusive";
+
+    EXPECT_ZERO_ALLOCATIONS(REQUIRE(Length(shared) == 6); REQUIRE(Length(unique) == 7));
+    REQUIRE(shared.UseCount() == 1);
+
+    BorrowedPtr<Node> node = intrusive;
+    REQUIRE(node->name == "intrusive");
+    REQUIRE(intrusive.UseCount() == 1);
+
+    BorrowedPtr<std::string> empty;
+    REQUIRE(!empty);
+    REQUIRE(!BorrowedPtr<std::string>(nullptr));
+    REQUIRE(!BorrowedPtr<std::string>(SharedPtr<std::string>()));
+}
+
+TEST_CASE("BorrowedPtr to base") {
+    auto shared = MakeShared<Derived>();
+    REQUIRE(BaseValue(shared) == 1);
+
+    BorrowedPtr<Base> base = shared;
+    auto promoted = base.ToShared();
+    REQUIRE(shared.UseCount() == 2);
+    REQUIRE(promoted.Get() == shared.Get());
+}
+
+TEST_CASE("BorrowedPtr promotion") {
+    SharedPtr<std::string> promoted;
+    {
+        auto owner = MakeShared<std::string>("value");
+        BorrowedPtr<std::string> view = owner;
+        BorrowedPtr<std::string> copy = view;
+        promoted = copy.ToShared();
+        REQUIRE(owner.UseCount() == 2);
+    }
+    REQUIRE(promoted.UseCount() == 1);
+    REQUIRE(*promoted == "value");
+    REQUIRE(!BorrowedPtr<std::string>().ToShared());
+
+    auto intrusive = MakeIntrusive<Node>();
+    BorrowedPtr<Node> node = intrusive;
+    IntrusivePtr<Node> again = node.ToIntrusive();
+    REQUIRE(intrusive.UseCount() == 2);
+}
+
+#if SMART_PTRS_CHECK_BORROWS
+
+TEST_CASE("BorrowedPtr detects a dead owner") {
+    pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        BorrowedPtr<int> view;
+        {
+            auto owner = MakeShared<int>(42);
+            view = owner;
+        }
+        volatile int value = *view;
+        (void)value;
+        _exit(0);
+    }
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGABRT);
+}
+
+#else
+
+TEST_CASE("BorrowedPtr is trivial") {
+    STATIC_REQUIRE(std::is_trivially_copyable_v<BorrowedPtr<int>>);
+    STATIC_REQUIRE(sizeof(BorrowedPtr<int>) == 2 * sizeof(void*));
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "buffer.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Packet pipeline: allocate a packet, cut header / body / trailer out of it and
+// forward the pieces through a queue. Run with `test_buffer [bench]`.
+
+namespace {
+
+constexpr int kPackets = 1 << 20;
+constexpr size_t kPacketSize = 1500;
+constexpr size_t kHeaderSize = 40;
+constexpr size_t kTrailerSize = 4;
+
+struct VectorSlice {
+    std::shared_ptr<std::vector<char>> buffer;
+    size_t offset;
+    size_t length;
+};
+
+template <typename F>
+double MeasureNs(F&& run) {
+    auto begin = std::chrono::steady_clock::now();
+    run();
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kPackets;
+}
+
+}  // namespace
+
+TEST_CASE("BufferSlice vs shared_ptr<vector<char>>", "[.bench]") {
+    size_t checksum = 0;
+
+    double slice_ns = MeasureNs([&] {
+        std::vector<BufferSlice> queue;
+        queue.reserve(3);
+        for (int i = 0; i < kPackets; ++i) {
+            BufferSlice packet(MakeBuffer(kPacketSize));
+            packet.MutableData()[0] = static_cast<char>(i);
+            queue.push_back(packet.SplitFront(kHeaderSize));
+            queue.push_back(packet.SplitBack(packet.Size() - kTrailerSize));
+            queue.push_back(std::move(packet));
+            for (auto& piece : queue) {
+                checksum += piece.Size();
+            }
+            queue.clear();
+        }
+    });
+
+    double vector_ns = MeasureNs([&] {
+        std::vector<VectorSlice> queue;
+        queue.reserve(3);
+        for (int i = 0; i < kPackets; ++i) {
+            auto buffer = std::make_shared<std::vector<char>>(kPacketSize);
+            (*buffer)[0] = static_cast<char>(i);
+            size_t body = kPacketSize - kHeaderSize - kTrailerSize;
+            queue.push_back({buffer, 0, kHeaderSize});
+            queue.push_back({buffer, kHeaderSize + body, kTrailerSize});
+            queue.push_back({std::move(buffer), kHeaderSize, body});
+            for (auto& piece : queue) {
+                checksum += piece.length;
+            }
+            queue.clear();
+        }
+    });
+
+    std::cout << "BufferSlice:\t\t\t" << slice_ns << " ns/packet, 1 allocation\n"
+              << "shared_ptr<vector<char>>:\t" << vector_ns << " ns/packet, 2 allocations\t("
+              << checksum << ")\n";
+}
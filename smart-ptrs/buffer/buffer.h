@@ -0,0 +1,151 @@
+#pragma once
+
+#include <intrusive/intrusive.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+class RefCountedBuffer;
+
+struct BufferDelete {
+    static void Destroy(RefCountedBuffer* buffer);
+};
+
+// Refcounted header followed by `Size()` bytes in the same allocation.
+// Create with MakeBuffer().
+class RefCountedBuffer : public RefCounted<RefCountedBuffer, AtomicCounter, BufferDelete> {
+    friend IntrusivePtr<RefCountedBuffer> MakeBuffer(size_t size);
+    friend IntrusivePtr<RefCountedBuffer> MakeBuffer(std::string_view data);
+
+public:
+    RefCountedBuffer(const RefCountedBuffer& other) = delete;
+    RefCountedBuffer& operator=(const RefCountedBuffer& other) = delete;
+
+    char* Data() {
+        return reinterpret_cast<char*>(this + 1);
+    }
+    const char* Data() const {
+        return reinterpret_cast<const char*>(this + 1);
+    }
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    explicit RefCountedBuffer(size_t size) : size_(size) {
+    }
+
+    static RefCountedBuffer* Allocate(size_t size) {
+        void* memory = ::operator new(sizeof(RefCountedBuffer) + size);
+        return new (memory) RefCountedBuffer(size);
+    }
+
+    size_t size_;
+};
+
+static_assert(sizeof(RefCountedBuffer) % alignof(std::max_align_t) == 0,
+              "Payload must keep the alignment of the allocation");
+
+inline void BufferDelete::Destroy(RefCountedBuffer* buffer) {
+    buffer->~RefCountedBuffer();
+    ::operator delete(buffer);
+}
+
+// Uninitialized buffer of `size` bytes.
+inline IntrusivePtr<RefCountedBuffer> MakeBuffer(size_t size) {
+    return IntrusivePtr<RefCountedBuffer>(RefCountedBuffer::Allocate(size));
+}
+
+// Buffer holding a copy of `data`.
+inline IntrusivePtr<RefCountedBuffer> MakeBuffer(std::string_view data) {
+    RefCountedBuffer* buffer = RefCountedBuffer::Allocate(data.size());
+    std::memcpy(buffer->Data(), data.data(), data.size());
+    return IntrusivePtr<RefCountedBuffer>(buffer);
+}
+
+// View of `[offset, offset + length)` inside a RefCountedBuffer that keeps the
+// buffer alive. Slicing and splitting only adjust the bounds and bump the counter:
+// no bytes are copied and nothing is allocated.
+class BufferSlice {
+public:
+    // Constructors
+
+    BufferSlice() {
+    }
+    BufferSlice(IntrusivePtr<RefCountedBuffer> buffer)
+        : buffer_(std::move(buffer)), length_(buffer_ ? buffer_->Size() : 0) {
+    }
+    BufferSlice(IntrusivePtr<RefCountedBuffer> buffer, size_t offset, size_t length)
+        : buffer_(std::move(buffer)), offset_(offset), length_(length) {
+        assert(buffer_ ? offset + length <= buffer_->Size() : length == 0);
+    }
+
+    // Modifiers
+
+    // Returns the first `n` bytes and drops them from this slice.
+    BufferSlice SplitFront(size_t n) {
+        assert(n <= length_);
+        BufferSlice front(buffer_, offset_, n);
+        offset_ += n;
+        length_ -= n;
+        return front;
+    }
+    // Returns the bytes after the first `n` and drops them from this slice.
+    BufferSlice SplitBack(size_t n) {
+        assert(n <= length_);
+        BufferSlice back(buffer_, offset_ + n, length_ - n);
+        length_ = n;
+        return back;
+    }
+    void TrimFront(size_t n) {
+        assert(n <= length_);
+        offset_ += n;
+        length_ -= n;
+    }
+    void TrimBack(size_t n) {
+        assert(n <= length_);
+        length_ -= n;
+    }
+    void Reset() {
+        buffer_.Reset();
+        offset_ = 0;
+        length_ = 0;
+    }
+
+    // Observers
+
+    BufferSlice Slice(size_t offset, size_t length) const {
+        assert(offset + length <= length_);
+        return BufferSlice(buffer_, offset_ + offset, length);
+    }
+    const char* Data() const {
+        return buffer_ ? buffer_->Data() + offset_ : nullptr;
+    }
+    char* MutableData() const {
+        return buffer_ ? buffer_->Data() + offset_ : nullptr;
+    }
+    size_t Size() const {
+        return length_;
+    }
+    bool Empty() const {
+        return length_ == 0;
+    }
+    size_t Offset() const {
+        return offset_;
+    }
+    std::string_view View() const {
+        return std::string_view(Data(), length_);
+    }
+    const IntrusivePtr<RefCountedBuffer>& Buffer() const {
+        return buffer_;
+    }
+
+private:
+    IntrusivePtr<RefCountedBuffer> buffer_;
+    size_t offset_ = 0;
+    size_t length_ = 0;
+};
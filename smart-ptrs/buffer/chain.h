@@ -0,0 +1,225 @@
+#pragma once
+
+#include "buffer.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Sequence of refcounted segments forming one logical message.
+// Segments are BufferSlice-s, so a buffer stays alive exactly as long as some
+// chain (or slice) still refers to it; appending, splitting and trimming never
+// copy bytes. Only Coalesce() copies.
+class BufferChain {
+public:
+    // Constructors
+
+    BufferChain() {
+    }
+    BufferChain(BufferSlice slice) {
+        Append(std::move(slice));
+    }
+
+    BufferChain(const BufferChain& other) = default;
+    BufferChain(BufferChain&& other)
+        : segments_(std::move(other.segments_)), size_(std::exchange(other.size_, 0)) {
+        other.segments_.clear();
+    }
+
+    // `operator=`-s
+
+    BufferChain& operator=(const BufferChain& other) = default;
+    BufferChain& operator=(BufferChain&& other) {
+        if (this != &other) {
+            segments_ = std::move(other.segments_);
+            size_ = std::exchange(other.size_, 0);
+            other.segments_.clear();
+        }
+        return *this;
+    }
+
+    // Modifiers
+
+    void Append(BufferSlice slice) {
+        if (!slice.Empty()) {
+            size_ += slice.Size();
+            segments_.push_back(std::move(slice));
+        }
+    }
+    void Append(BufferChain other) {
+        for (auto& slice : other.segments_) {
+            segments_.push_back(std::move(slice));
+        }
+        size_ += other.size_;
+        other.Clear();
+    }
+    void Prepend(BufferSlice slice) {
+        if (!slice.Empty()) {
+            size_ += slice.Size();
+            segments_.push_front(std::move(slice));
+        }
+    }
+    void Prepend(BufferChain other) {
+        for (auto it = other.segments_.rbegin(); it != other.segments_.rend(); ++it) {
+            segments_.push_front(std::move(*it));
+        }
+        size_ += other.size_;
+        other.Clear();
+    }
+
+    // Returns the first `n` bytes and drops them from this chain.
+    BufferChain SplitFront(size_t n) {
+        assert(n <= size_);
+        BufferChain front;
+        size_ -= n;
+        while (n != 0) {
+            BufferSlice& head = segments_.front();
+            if (head.Size() <= n) {
+                n -= head.Size();
+                front.Append(std::move(head));
+                segments_.pop_front();
+            } else {
+                front.Append(head.SplitFront(n));
+                n = 0;
+            }
+        }
+        return front;
+    }
+    void TrimFront(size_t n) {
+        assert(n <= size_);
+        size_ -= n;
+        while (n != 0) {
+            BufferSlice& head = segments_.front();
+            if (head.Size() <= n) {
+                n -= head.Size();
+                segments_.pop_front();
+            } else {
+                head.TrimFront(n);
+                n = 0;
+            }
+        }
+    }
+    void TrimBack(size_t n) {
+        assert(n <= size_);
+        size_ -= n;
+        while (n != 0) {
+            BufferSlice& tail = segments_.back();
+            if (tail.Size() <= n) {
+                n -= tail.Size();
+                segments_.pop_back();
+            } else {
+                tail.TrimBack(n);
+                n = 0;
+            }
+        }
+    }
+    // Copies all bytes into a single fresh buffer. Does nothing for 0 or 1 segments.
+    void Coalesce() {
+        if (segments_.size() <= 1) {
+            return;
+        }
+        auto buffer = MakeBuffer(size_);
+        CopyTo(buffer->Data());
+        segments_.clear();
+        segments_.emplace_back(std::move(buffer));
+    }
+    void Clear() {
+        segments_.clear();
+        size_ = 0;
+    }
+
+    // Observers
+
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+    size_t NumSegments() const {
+        return segments_.size();
+    }
+    const BufferSlice& Segment(size_t i) const {
+        return segments_[i];
+    }
+    void CopyTo(char* out) const {
+        for (const auto& slice : segments_) {
+            std::memcpy(out, slice.Data(), slice.Size());
+            out += slice.Size();
+        }
+    }
+    std::string ToString() const {
+        std::string result(size_, '\0');
+        CopyTo(result.data());
+        return result;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Scatter-gather I/O
+
+    // Fills at most `max` entries, returns the number of entries used.
+    size_t FillIovec(iovec* iov, size_t max) const {
+        size_t count = std::min(max, segments_.size());
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<char*>(segments_[i].Data());
+            iov[i].iov_len = segments_[i].Size();
+        }
+        return count;
+    }
+    std::vector<iovec> ToIovec() const {
+        std::vector<iovec> iov(segments_.size());
+        FillIovec(iov.data(), iov.size());
+        return iov;
+    }
+
+    // One writev() call; written bytes are dropped from the front of the chain.
+    // Returns what writev() returned.
+    ssize_t WriteTo(int fd) {
+        iovec iov[kMaxIovec];
+        size_t count = FillIovec(iov, kMaxIovec);
+        ssize_t written = ::writev(fd, iov, static_cast<int>(count));
+        if (written > 0) {
+            TrimFront(written);
+        }
+        return written;
+    }
+
+    // One readv() call of up to `max_bytes` into fresh buffers of `segment_size`
+    // bytes; what was read is appended to the chain. Returns what readv() returned.
+    // Throws std::invalid_argument if `segment_size` is 0.
+    ssize_t ReadFrom(int fd, size_t max_bytes, size_t segment_size = kDefaultSegmentSize) {
+        if (segment_size == 0) {
+            throw std::invalid_argument("Bad BufferChain segment size");
+        }
+        size_t count = std::min(kMaxIovec, (max_bytes + segment_size - 1) / segment_size);
+        IntrusivePtr<RefCountedBuffer> buffers[kMaxIovec];
+        iovec iov[kMaxIovec];
+        for (size_t i = 0; i < count; ++i) {
+            size_t size = std::min(segment_size, max_bytes - i * segment_size);
+            buffers[i] = MakeBuffer(size);
+            iov[i].iov_base = buffers[i]->Data();
+            iov[i].iov_len = size;
+        }
+        ssize_t read = ::readv(fd, iov, static_cast<int>(count));
+        size_t left = read > 0 ? read : 0;
+        for (size_t i = 0; i < count && left != 0; ++i) {
+            size_t used = std::min(left, iov[i].iov_len);
+            Append(BufferSlice(std::move(buffers[i]), 0, used));
+            left -= used;
+        }
+        return read;
+    }
+
+    static constexpr size_t kMaxIovec = std::min<size_t>(IOV_MAX, 64);
+    static constexpr size_t kDefaultSegmentSize = 4096;
+
+private:
+    std::deque<BufferSlice> segments_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,95 @@
+#include "buffer.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("RefCountedBuffer") {
+    SECTION("One allocation") {
+        EXPECT_ONE_ALLOCATION(auto buffer = MakeBuffer(1500); REQUIRE(buffer->Size() == 1500););
+    }
+
+    SECTION("Payload follows the header") {
+        auto buffer = MakeBuffer("abacaba");
+        REQUIRE(buffer->Size() == 7);
+        REQUIRE(buffer->Data() == reinterpret_cast<char*>(buffer.Get() + 1));
+        REQUIRE(std::string_view(buffer->Data(), buffer->Size()) == "abacaba");
+    }
+
+    SECTION("Empty") {
+        auto buffer = MakeBuffer(0);
+        REQUIRE(buffer->Size() == 0);
+        BufferSlice slice(buffer);
+        REQUIRE(slice.Empty());
+    }
+}
+
+TEST_CASE("BufferSlice") {
+    SECTION("Default") {
+        BufferSlice slice;
+        REQUIRE(slice.Empty());
+        REQUIRE(slice.Data() == nullptr);
+        REQUIRE(slice.View().empty());
+    }
+
+    SECTION("Slice") {
+        auto buffer = MakeBuffer("header|payload|trailer");
+        BufferSlice packet(buffer);
+        BufferSlice payload = packet.Slice(7, 7);
+        REQUIRE(payload.View() == "payload");
+        REQUIRE(payload.Data() == buffer->Data() + 7);
+        REQUIRE(buffer.UseCount() == 3);
+        REQUIRE(payload.Slice(1, 3).View() == "ayl");
+    }
+
+    SECTION("Split and trim") {
+        BufferSlice packet(MakeBuffer("header|payload|trailer"));
+        BufferSlice header = packet.SplitFront(7);
+        REQUIRE(header.View() == "header|");
+        REQUIRE(packet.View() == "payload|trailer");
+
+        BufferSlice trailer = packet.SplitBack(8);
+        REQUIRE(packet.View() == "payload|");
+        REQUIRE(trailer.View() == "trailer");
+
+        packet.TrimBack(1);
+        header.TrimFront(3);
+        header.TrimBack(1);
+        REQUIRE(packet.View() == "payload");
+        REQUIRE(header.View() == "der");
+        REQUIRE(header.Buffer().UseCount() == 3);
+    }
+
+    SECTION("Zero copies and allocations") {
+        BufferSlice packet(MakeBuffer(std::string(1500, 'x')));
+        std::vector<BufferSlice> queue;
+        queue.reserve(4);
+        EXPECT_ZERO_ALLOCATIONS({
+            BufferSlice copy = packet;
+            BufferSlice header = copy.SplitFront(40);
+            BufferSlice body = copy.Slice(0, 1000);
+            queue.push_back(std::move(header));
+            queue.push_back(std::move(body));
+            queue.push_back(packet);
+        });
+        REQUIRE(queue[1].Data() == packet.Data() + 40);
+        REQUIRE(packet.Buffer().UseCount() == 4);
+    }
+
+    SECTION("Buffer outlives the first owner") {
+        BufferSlice body;
+        {
+            BufferSlice packet(MakeBuffer("0123456789"));
+            body = packet.Slice(2, 5);
+        }
+        REQUIRE(body.View() == "23456");
+        REQUIRE(body.Buffer().UseCount() == 1);
+        body.Reset();
+        REQUIRE(body.Empty());
+    }
+}
@@ -0,0 +1,121 @@
+#include "chain.h"
+
+#include <catch.hpp>
+
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+BufferChain MakeMessage(const IntrusivePtr<RefCountedBuffer>& body) {
+    BufferChain message(MakeBuffer("header:"));
+    message.Append(BufferSlice(body));
+    message.Append(BufferSlice(MakeBuffer(";end")));
+    return message;
+}
+
+}  // namespace
+
+TEST_CASE("BufferChain") {
+    auto body = MakeBuffer("shared body");
+
+    SECTION("Append / Prepend") {
+        BufferChain message = MakeMessage(body);
+        REQUIRE(message.NumSegments() == 3);
+        REQUIRE(message.Size() == 22);
+        REQUIRE(message.ToString() == "header:shared body;end");
+        REQUIRE(message.Segment(1).Data() == body->Data());
+
+        message.Prepend(BufferSlice(MakeBuffer(">")));
+        BufferChain tail(BufferSlice(MakeBuffer("!")));
+        message.Append(std::move(tail));
+        REQUIRE(tail.Empty());
+        REQUIRE(message.ToString() == ">header:shared body;end!");
+
+        BufferChain head(BufferSlice(MakeBuffer("0")));
+        head.Append(BufferSlice(MakeBuffer("1")));
+        message.Prepend(std::move(head));
+        REQUIRE(message.ToString() == "01>header:shared body;end!");
+
+        message.Append(BufferSlice());
+        REQUIRE(message.NumSegments() == 7);
+    }
+
+    SECTION("Pins segments") {
+        {
+            BufferChain first = MakeMessage(body);
+            BufferChain second = MakeMessage(body);
+            REQUIRE(body.UseCount() == 3);
+            first.Clear();
+            REQUIRE(body.UseCount() == 2);
+        }
+        REQUIRE(body.UseCount() == 1);
+    }
+
+    SECTION("Split") {
+        BufferChain message = MakeMessage(body);
+        BufferChain header = message.SplitFront(10);
+        REQUIRE(header.ToString() == "header:sha");
+        REQUIRE(header.NumSegments() == 2);
+        REQUIRE(message.ToString() == "red body;end");
+        REQUIRE(message.Size() == 12);
+        REQUIRE(message.Segment(0).Data() == body->Data() + 3);
+
+        BufferChain rest = message.SplitFront(message.Size());
+        REQUIRE(message.Empty());
+        REQUIRE(message.NumSegments() == 0);
+        REQUIRE(rest.ToString() == "red body;end");
+    }
+
+    SECTION("Trim") {
+        BufferChain message = MakeMessage(body);
+        message.TrimFront(7);
+        REQUIRE(message.NumSegments() == 2);
+        message.TrimBack(5);
+        REQUIRE(message.NumSegments() == 1);
+        REQUIRE(message.ToString() == "shared bod");
+        message.TrimFront(1);
+        message.TrimBack(1);
+        REQUIRE(message.ToString() == "hared bo");
+        REQUIRE(message.Size() == 8);
+    }
+
+    SECTION("Coalesce") {
+        BufferChain message = MakeMessage(body);
+        message.Coalesce();
+        REQUIRE(message.NumSegments() == 1);
+        REQUIRE(message.ToString() == "header:shared body;end");
+        REQUIRE(body.UseCount() == 1);
+    }
+}
+
+TEST_CASE("BufferChain scatter-gather") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+
+    auto body = MakeBuffer("shared body");
+    BufferChain message = MakeMessage(body);
+
+    auto iov = message.ToIovec();
+    REQUIRE(iov.size() == 3);
+    REQUIRE(iov[1].iov_base == body->Data());
+    REQUIRE(iov[1].iov_len == body->Size());
+
+    REQUIRE(message.WriteTo(fds[1]) == 22);
+    REQUIRE(message.Empty());
+    REQUIRE(body.UseCount() == 1);
+
+    BufferChain received;
+    REQUIRE(received.ReadFrom(fds[0], 100, 8) == 22);
+    REQUIRE(received.NumSegments() == 3);
+    REQUIRE(received.Segment(2).Size() == 6);
+    REQUIRE(received.ToString() == "header:shared body;end");
+    REQUIRE_THROWS_AS(received.ReadFrom(fds[0], 100, 0), std::invalid_argument);
+
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,101 @@
+#include "compressed.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// A binary tree over random keys: build, lookups, copies of child pointers and
+// teardown, with regular IntrusivePtr nodes and with compressed nodes in an arena.
+// Run with `test_compressed [bench]`.
+
+namespace {
+
+constexpr int kNodes = 1 << 20;
+constexpr int kLookups = 1 << 22;
+
+struct RegularNode : RefCounted<RegularNode, NarrowCounter<uint32_t>, DefaultDelete> {
+    explicit RegularNode(uint32_t key) : key(key) {
+    }
+
+    uint32_t key;
+    IntrusivePtr<RegularNode> left;
+    IntrusivePtr<RegularNode> right;
+};
+
+struct Tag;
+using Heap = OffsetArena<Tag, 2>;
+
+struct CompressedNode
+    : RefCounted<CompressedNode, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {
+    explicit CompressedNode(uint32_t key) : key(key) {
+    }
+
+    uint32_t key;
+    CompressedIntrusivePtr<CompressedNode, Heap> left;
+    CompressedIntrusivePtr<CompressedNode, Heap> right;
+};
+
+double Seconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+template <typename Ptr, typename Make>
+void Run(const char* name, Make make) {
+    std::mt19937 gen(42);
+    std::vector<uint32_t> keys(kNodes);
+    for (auto& key : keys) {
+        key = gen();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    Ptr root = make(keys[0]);
+    for (int i = 1; i < kNodes; ++i) {
+        Ptr* slot = &root;
+        while (*slot) {
+            slot = keys[i] < (*slot)->key ? &(*slot)->left : &(*slot)->right;
+        }
+        *slot = make(keys[i]);
+    }
+    double build = Seconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    int64_t found = 0;
+    for (int i = 0; i < kLookups; ++i) {
+        uint32_t key = keys[gen() % kNodes];
+        auto node = root.Get();
+        while (node && node->key != key) {
+            node = (key < node->key ? node->left : node->right).Get();
+        }
+        if (node) {
+            // Hands the result out like a lookup API would.
+            Ptr result(node);
+            found += result->key == key;
+        }
+    }
+    double lookups = Seconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    root.Reset();
+    double teardown = Seconds(begin);
+
+    std::cout << name << "\tnode " << sizeof(*root.Get()) << " B\tbuild " << build
+              << " s\tlookups " << kLookups / lookups / 1e6 << " M/s\tteardown " << teardown
+              << " s\t(found " << found << ")\n";
+}
+
+}  // namespace
+
+TEST_CASE("Compressed tree", "[.bench]") {
+    Run<IntrusivePtr<RegularNode>>("IntrusivePtr", [](uint32_t key) {
+        return MakeIntrusive<RegularNode>(key);
+    });
+
+    Heap heap(size_t{64} << 20);
+    Run<CompressedIntrusivePtr<CompressedNode, Heap>>(
+        "Compressed", [&](uint32_t key) { return heap.MakeIntrusive<CompressedNode>(key); });
+    std::cout << "arena used " << heap.UsedBytes() / (1 << 20) << " MiB\n";
+}
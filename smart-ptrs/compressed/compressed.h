@@ -0,0 +1,350 @@
+#pragma once
+
+#include <core/granule_heap.h>
+#include <intrusive/intrusive.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Pointers that store a 32-bit offset into an arena instead of a 64-bit address.
+//
+// OffsetArena<Tag, Shift> is one contiguous region; offsets count granules of
+// 2^Shift bytes from its base, so an arena spans up to 2^(32 + Shift) bytes (32 GiB
+// for the default 8-byte granule) and every object in it has to be aligned to at
+// most a granule. The base is a static of the arena type: decoding is a shift and an
+// add, and a pointer is 4 bytes. Offset 0 is never handed out and means nullptr.
+//
+//     struct Tag;
+//     using Heap = OffsetArena<Tag>;
+//     struct Node : RefCounted<Node, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {
+//         CompressedIntrusivePtr<Node, Heap> next;
+//     };
+//     Heap heap(1 << 30);
+//     CompressedIntrusivePtr<Node, Heap> node = heap.MakeIntrusive<Node>();
+//
+// Only one arena of a type is alive at a time. The arena is not thread-safe and has
+// to outlive its objects.
+
+template <typename T, typename Arena>
+class CompressedUniquePtr;
+template <typename T, typename Arena>
+class CompressedIntrusivePtr;
+
+template <typename Tag, size_t Shift = 3>
+class OffsetArena {
+public:
+    static constexpr size_t kGranule = size_t{1} << Shift;
+    static constexpr size_t kMaxCapacity = kGranule << 32;
+
+    // The whole capacity is allocated at once with ::operator new. The first granule
+    // stands for nullptr, so the arena needs at least two.
+    explicit OffsetArena(size_t capacity)
+        : capacity_(std::min((capacity + kGranule - 1) / kGranule * kGranule, kMaxCapacity)) {
+        assert(!instance_ && "Only one OffsetArena of a type at a time");
+        if (capacity_ < 2 * kGranule) {
+            throw std::invalid_argument("Bad OffsetArena capacity");
+        }
+        base_ = static_cast<char*>(::operator new(capacity_, kAlignment));
+        instance_ = this;
+    }
+
+    OffsetArena(const OffsetArena& other) = delete;
+    OffsetArena& operator=(const OffsetArena& other) = delete;
+
+    ~OffsetArena() {
+        assert(heap_.live == 0 && "OffsetArena destroyed before its objects");
+        ::operator delete(base_, kAlignment);
+        base_ = nullptr;
+        instance_ = nullptr;
+    }
+
+    static OffsetArena& Instance() {
+        return *instance_;
+    }
+
+    static uint32_t Encode(const void* ptr) {
+        if (!ptr) {
+            return 0;
+        }
+        return static_cast<uint32_t>((static_cast<const char*>(ptr) - base_) >> Shift);
+    }
+    // `offset` must not be 0.
+    template <typename T>
+    static T* Decode(uint32_t offset) {
+        return reinterpret_cast<T*>(base_ + (size_t{offset} << Shift));
+    }
+
+    // Throws std::bad_alloc when the arena is full.
+    void* Allocate(size_t size) {
+        return heap_.Allocate(base_, capacity_ >> Shift, size);
+    }
+    // Blocks are kept on a free list per size class and reused by Allocate.
+    void Deallocate(void* block, size_t size) {
+        heap_.Deallocate(base_, block, size);
+    }
+
+    template <typename T, typename... Args>
+    CompressedUniquePtr<T, OffsetArena> MakeUnique(Args&&... args) {
+        return CompressedUniquePtr<T, OffsetArena>(Construct<T>(std::forward<Args>(args)...));
+    }
+    // T is RefCounted with OffsetArenaDelete<OffsetArena>.
+    template <typename T, typename... Args>
+    CompressedIntrusivePtr<T, OffsetArena> MakeIntrusive(Args&&... args) {
+        return CompressedIntrusivePtr<T, OffsetArena>(Construct<T>(std::forward<Args>(args)...));
+    }
+
+    size_t LiveObjects() const {
+        return heap_.live;
+    }
+    // Bytes taken from the arena so far, including blocks on the free lists.
+    size_t UsedBytes() const {
+        return heap_.used << Shift;
+    }
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+private:
+    static constexpr std::align_val_t kAlignment{
+        kGranule > alignof(std::max_align_t) ? kGranule : alignof(std::max_align_t)};
+
+    template <typename T, typename... Args>
+    T* Construct(Args&&... args) {
+        static_assert(alignof(T) <= kGranule, "Objects must fit the granule alignment");
+        void* block = Allocate(sizeof(T));
+        try {
+            return new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(block, sizeof(T));
+            throw;
+        }
+    }
+
+    static inline char* base_ = nullptr;
+    static inline OffsetArena* instance_ = nullptr;
+
+    size_t capacity_;
+    // Granule 0 stays unused for nullptr.
+    core::GranuleHeap<uint32_t, Shift> heap_{.used = 1};
+};
+
+// Deleter for RefCounted objects created by `Arena::MakeIntrusive`.
+template <typename Arena>
+struct OffsetArenaDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        object->~T();
+        Arena::Instance().Deallocate(object, sizeof(T));
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CompressedUniquePtr
+
+// Owns an object created by `Arena::MakeUnique`. No conversions between types:
+// the object is freed with sizeof(T).
+template <typename T, typename Arena>
+class CompressedUniquePtr {
+    friend Arena;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    CompressedUniquePtr() {
+    }
+    CompressedUniquePtr(std::nullptr_t) {
+    }
+
+    CompressedUniquePtr(const CompressedUniquePtr& other) = delete;
+    CompressedUniquePtr(CompressedUniquePtr&& other) : offset_(std::exchange(other.offset_, 0)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    CompressedUniquePtr& operator=(const CompressedUniquePtr& other) = delete;
+    CompressedUniquePtr& operator=(CompressedUniquePtr&& other) {
+        if (this != &other) {
+            Reset();
+            offset_ = std::exchange(other.offset_, 0);
+        }
+        return *this;
+    }
+    CompressedUniquePtr& operator=(std::nullptr_t) {
+        Reset();
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~CompressedUniquePtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Returns the object without destroying it; free it with Arena::Deallocate.
+    T* Release() {
+        return Decode(std::exchange(offset_, 0));
+    }
+    void Reset() {
+        if (T* ptr = Release()) {
+            ptr->~T();
+            Arena::Instance().Deallocate(ptr, sizeof(T));
+        }
+    }
+    void Swap(CompressedUniquePtr& other) {
+        std::swap(offset_, other.offset_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return Decode(offset_);
+    }
+    T& operator*() const {
+        return *Arena::template Decode<T>(offset_);
+    }
+    T* operator->() const {
+        return Arena::template Decode<T>(offset_);
+    }
+    uint32_t Offset() const {
+        return offset_;
+    }
+    explicit operator bool() const {
+        return offset_ != 0;
+    }
+
+private:
+    explicit CompressedUniquePtr(T* ptr) : offset_(Arena::Encode(ptr)) {
+    }
+
+    static T* Decode(uint32_t offset) {
+        return offset ? Arena::template Decode<T>(offset) : nullptr;
+    }
+
+    uint32_t offset_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// CompressedIntrusivePtr
+
+// Same contract as IntrusivePtr for objects that live in `Arena`.
+template <typename T, typename Arena>
+class CompressedIntrusivePtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    CompressedIntrusivePtr() {
+    }
+    CompressedIntrusivePtr(std::nullptr_t) {
+    }
+    // `ptr` must point into the arena.
+    explicit CompressedIntrusivePtr(T* ptr) : offset_(Arena::Encode(ptr)) {
+        if (ptr) {
+            ptr->IncRef();
+        }
+    }
+
+    CompressedIntrusivePtr(const CompressedIntrusivePtr& other) : offset_(other.offset_) {
+        if (offset_) {
+            Object()->IncRef();
+        }
+    }
+    CompressedIntrusivePtr(CompressedIntrusivePtr&& other)
+        : offset_(std::exchange(other.offset_, 0)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    CompressedIntrusivePtr& operator=(const CompressedIntrusivePtr& other) {
+        if (offset_ != other.offset_) {
+            if (other.offset_) {
+                other.Object()->IncRef();
+            }
+            Reset();
+            offset_ = other.offset_;
+        }
+        return *this;
+    }
+    CompressedIntrusivePtr& operator=(CompressedIntrusivePtr&& other) {
+        if (this != &other) {
+            Reset();
+            offset_ = std::exchange(other.offset_, 0);
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~CompressedIntrusivePtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (offset_) {
+            Arena::template Decode<T>(std::exchange(offset_, 0))->DecRef();
+        }
+    }
+    void Reset(T* ptr) {
+        *this = CompressedIntrusivePtr(ptr);
+    }
+    void Swap(CompressedIntrusivePtr& other) {
+        std::swap(offset_, other.offset_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return offset_ ? Object() : nullptr;
+    }
+    T& operator*() const {
+        return *Object();
+    }
+    T* operator->() const {
+        return Object();
+    }
+    size_t UseCount() const {
+        return offset_ ? Object()->RefCount() : 0;
+    }
+    uint32_t Offset() const {
+        return offset_;
+    }
+    explicit operator bool() const {
+        return offset_ != 0;
+    }
+
+    // Promotion to a regular 8-byte pointer (e.g. to hand out of the graph).
+    IntrusivePtr<T> ToIntrusive() const {
+        return offset_ ? IntrusivePtr<T>(Object()) : IntrusivePtr<T>();
+    }
+
+private:
+    T* Object() const {
+        return Arena::template Decode<T>(offset_);
+    }
+
+    uint32_t offset_ = 0;
+};
+
+template <typename T, typename Arena>
+bool operator==(const CompressedIntrusivePtr<T, Arena>& left,
+                const CompressedIntrusivePtr<T, Arena>& right) {
+    return left.Offset() == right.Offset();
+}
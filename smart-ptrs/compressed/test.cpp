@@ -0,0 +1,137 @@
+#include "compressed.h"
+
+#include <catch.hpp>
+
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tag;
+using Heap = OffsetArena<Tag>;
+
+struct Node : RefCounted<Node, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {
+    explicit Node(int value = 0) : value(value) {
+        ++alive;
+    }
+    ~Node() {
+        --alive;
+    }
+
+    int value;
+    CompressedIntrusivePtr<Node, Heap> next;
+
+    static inline int alive = 0;
+};
+
+struct SmallTag;
+using SmallHeap = OffsetArena<SmallTag, 2>;
+
+struct SmallNode : RefCounted<SmallNode, NarrowCounter<uint32_t>, OffsetArenaDelete<SmallHeap>> {
+    uint32_t value = 0;
+    CompressedIntrusivePtr<SmallNode, SmallHeap> next;
+};
+
+}  // namespace
+
+TEST_CASE("Compressed pointers are 4 bytes") {
+    STATIC_REQUIRE(sizeof(CompressedIntrusivePtr<Node, Heap>) == 4);
+    STATIC_REQUIRE(sizeof(CompressedUniquePtr<std::string, Heap>) == 4);
+    STATIC_REQUIRE(sizeof(SmallNode) == 12);
+    STATIC_REQUIRE(Heap::kMaxCapacity == size_t{32} << 30);
+}
+
+TEST_CASE("CompressedUniquePtr") {
+    Heap heap(1 << 20);
+    CompressedUniquePtr<std::string, Heap> empty;
+    REQUIRE(!empty);
+    REQUIRE(empty.Get() == nullptr);
+
+    auto str = heap.MakeUnique<std::string>("compressed");
+    REQUIRE(str);
+    REQUIRE(*str == "compressed");
+    REQUIRE(str->size() == 10);
+    REQUIRE(Heap::Encode(str.Get()) == str.Offset());
+    REQUIRE(heap.LiveObjects() == 1);
+
+    auto moved = std::move(str);
+    REQUIRE(!str);
+    REQUIRE(*moved == "compressed");
+
+    moved = nullptr;
+    REQUIRE(heap.LiveObjects() == 0);
+}
+
+TEST_CASE("CompressedIntrusivePtr") {
+    Heap heap(1 << 20);
+    {
+        auto head = heap.MakeIntrusive<Node>(1);
+        REQUIRE(head.UseCount() == 1);
+        head->next = heap.MakeIntrusive<Node>(2);
+        head->next->next = heap.MakeIntrusive<Node>(3);
+        REQUIRE(Node::alive == 3);
+
+        auto second = head->next;
+        REQUIRE(second.UseCount() == 2);
+        REQUIRE(second == head->next);
+
+        int sum = 0;
+        for (Node* node = head.Get(); node; node = node->next.Get()) {
+            sum += node->value;
+        }
+        REQUIRE(sum == 6);
+
+        head->next.Reset();
+        REQUIRE(Node::alive == 3);
+        second.Reset();
+        REQUIRE(Node::alive == 1);
+
+        IntrusivePtr<Node> regular = head.ToIntrusive();
+        head.Reset();
+        REQUIRE(Node::alive == 1);
+        REQUIRE(regular->value == 1);
+    }
+    REQUIRE(Node::alive == 0);
+    REQUIRE(heap.LiveObjects() == 0);
+}
+
+TEST_CASE("Freed blocks are reused") {
+    Heap heap(1 << 20);
+    auto first = heap.MakeIntrusive<Node>(1);
+    uint32_t offset = first.Offset();
+    first.Reset();
+    size_t used = heap.UsedBytes();
+
+    auto second = heap.MakeIntrusive<Node>(2);
+    REQUIRE(second.Offset() == offset);
+    REQUIRE(heap.UsedBytes() == used);
+}
+
+TEST_CASE("Full arena") {
+    SmallHeap heap(1024);
+    std::vector<CompressedIntrusivePtr<SmallNode, SmallHeap>> nodes;
+    REQUIRE_THROWS_AS(
+        [&] {
+            while (true) {
+                nodes.push_back(heap.MakeIntrusive<SmallNode>());
+            }
+        }(),
+        std::bad_alloc);
+    REQUIRE(nodes.size() == (1024 - 4) / sizeof(SmallNode));
+
+    nodes.pop_back();
+    nodes.push_back(heap.MakeIntrusive<SmallNode>());
+    nodes.clear();
+    REQUIRE(heap.LiveObjects() == 0);
+}
+
+TEST_CASE("Too small arena") {
+    REQUIRE_THROWS_AS(SmallHeap(0), std::invalid_argument);
+    REQUIRE_THROWS_AS(SmallHeap(4), std::invalid_argument);
+    SmallHeap heap(8);
+    REQUIRE_THROWS_AS(heap.MakeIntrusive<SmallNode>(), std::bad_alloc);
+}
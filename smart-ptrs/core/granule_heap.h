@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <typeinfo>
+
+namespace core {
+
+// Size-class allocator over a region addressed by offsets, shared by OffsetArena,
+// FileHeap and ShmSegment. The state is a plain struct, so it can live in a mapped
+// header as well as in an object; the caller passes the base of the region and
+// does the locking.
+//
+// Sizes are rounded up to granules of 2^Shift bytes: exact classes up to
+// kExactClasses granules, powers of two above. A freed block goes on the list of its
+// class and holds the offset (in granules) of the next one; fresh blocks are cut off
+// the end of the used part. Offset 0 is never handed out: the caller reserves the
+// first granules (nullptr, a header) by starting `used` above them.
+template <typename Offset, size_t Shift>
+struct GranuleHeap {
+    static constexpr size_t kGranule = size_t{1} << Shift;
+    static constexpr size_t kExactClasses = 64;
+    static constexpr size_t kNumClasses = kExactClasses + 8 * sizeof(Offset) + 1;
+
+    // Throws std::bad_alloc when `capacity` granules are used up.
+    void* Allocate(char* base, size_t capacity, size_t size) {
+        size_t granules;
+        size_t size_class = SizeClass(size, &granules);
+        if (Offset head = free[size_class]) {
+            free[size_class] = *At<Offset>(base, head);
+            ++live;
+            return At<void>(base, head);
+        }
+        if (granules > capacity - used) {
+            throw std::bad_alloc();
+        }
+        void* block = At<void>(base, used);
+        used += granules;
+        ++live;
+        return block;
+    }
+
+    void Deallocate(char* base, void* block, size_t size) {
+        size_t granules;
+        size_t size_class = SizeClass(size, &granules);
+        // The link reaches memory before the block is published, so a process killed
+        // between the two stores (ShmSegment) leaves a consistent list.
+        std::atomic_ref<Offset>(*static_cast<Offset*>(block))
+            .store(free[size_class], std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_release);
+        std::atomic_ref<Offset>(free[size_class])
+            .store(static_cast<Offset>((static_cast<char*>(block) - base) >> Shift),
+                   std::memory_order_relaxed);
+        --live;
+    }
+
+    static size_t SizeClass(size_t size, size_t* granules) {
+        size_t count = (std::max(size, sizeof(Offset)) + kGranule - 1) >> Shift;
+        if (count <= kExactClasses) {
+            *granules = count;
+            return count;
+        }
+        size_t log = std::bit_width(count - 1);
+        *granules = size_t{1} << log;
+        return kExactClasses + log - std::bit_width(kExactClasses - 1);
+    }
+
+    template <typename T>
+    static T* At(char* base, uint64_t offset) {
+        return reinterpret_cast<T*>(base + (offset << Shift));
+    }
+
+    // In granules, including the blocks on the free lists.
+    uint64_t used = 0;
+    uint64_t live = 0;
+    Offset free[kNumClasses] = {};
+};
+
+// FNV-1a hash of the type name: the same in every process and run of one binary, so
+// it can be stored in a file or a shared segment.
+template <typename T>
+uint64_t TypeKey() {
+    uint64_t key = 14695981039346656037u;
+    for (const char* c = typeid(T).name(); *c; ++c) {
+        key = (key ^ static_cast<unsigned char>(*c)) * 1099511628211u;
+    }
+    return key;
+}
+
+}  // namespace core
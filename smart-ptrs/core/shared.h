@@ -0,0 +1,651 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+
+#include <intrusive/intrusive.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>  // std::nullptr_t
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// https://en.cppreference.com/w/cpp/memory/shared_ptr
+
+// One SharedPtr / WeakPtr implementation for all modules. A module picks a policy
+// and names it SharedPolicy, which makes it the default of SharedPtr<T>:
+//
+//     struct SharedPolicy : core::Policy<AtomicCounter, true> {};
+//
+// Other policies may be used next to it as SharedPtr<T, OtherPolicy>.
+
+// Borrow checking (see BorrowedPtr) stamps every control block with a generation
+// that changes when the object dies. Off unless the build defines it to 1, in debug
+// builds too: it changes the layout of every control block, so all translation units
+// of a program must agree on it.
+#ifndef SMART_PTRS_CHECK_BORROWS
+#define SMART_PTRS_CHECK_BORROWS 0
+#endif
+
+// Reclaim policy of a control block: how the object and the block are freed once
+// their counters drop to zero. ReclaimNow frees them right away; a deferred policy
+// (e.g. EbrReclaim) calls `reclaim(block)` later.
+struct ReclaimNow {
+    static void Retire(void* block, void (*reclaim)(void*)) {
+        reclaim(block);
+    }
+};
+
+// Layout policy of ControlBlockMakeShared: alignment of the object inside the block.
+// CompactLayout keeps the counters and the object together, as small as possible.
+// CacheLinePadded<Line> moves the object to the next line and rounds the block up
+// to whole lines, so the counters of a hot object share a cache line neither with the
+// object data nor with neighboring allocations.
+struct CompactLayout {
+    template <typename T>
+    static constexpr size_t kObjectAlignment = alignof(T);
+};
+
+template <size_t Line = 64>
+struct CacheLinePadded {
+    static_assert(Line >= 32 && (Line & (Line - 1)) == 0);
+
+    template <typename T>
+    static constexpr size_t kObjectAlignment = alignof(T) > Line ? alignof(T) : Line;
+};
+
+namespace core {
+
+struct HeapAllocator {
+    static void* Allocate(size_t size) {
+        return ::operator new(size);
+    }
+    static void Deallocate(void* block, size_t size) {
+        ::operator delete(block, size);
+    }
+};
+
+// Policy of SharedPtr and its control blocks:
+//  * Counter: a counter from intrusive.h. It decides the width and the atomicity:
+//    SimpleCounter, AtomicCounter, NarrowCounter<uint32_t>, ...
+//  * kWeak: WeakPtr support. Without it the block has no weak counter at all.
+//  * BlockAllocator: memory of ControlBlockNew, `Allocate(size)` / `Deallocate(block, size)`.
+//  * Deleter: destroys objects adopted from raw pointers, `Destroy(T*)` as in intrusive.h.
+template <typename CounterType, bool Weak, typename BlockAllocatorType = HeapAllocator,
+          typename DeleterType = DefaultDelete>
+struct Policy {
+    using Counter = CounterType;
+    static constexpr bool kWeak = Weak;
+    using BlockAllocator = BlockAllocatorType;
+    using Deleter = DeleterType;
+};
+
+struct NoWeakCounter {};
+
+// Strong owners together hold one weak reference, so the block always outlives the
+// object and no counter is ever read to decide on a free. Decrements are not virtual:
+// the block is called only when a counter drops to zero.
+template <typename Policy>
+struct ControlBlockBase {
+    using Counter = typename Policy::Counter;
+
+    ControlBlockBase() {
+        if constexpr (Policy::kWeak) {
+            weak_ref_cnt_.IncRef();
+        }
+    }
+
+    void IncStrongRefCnt() {
+        strong_ref_cnt_.IncRef();
+    }
+
+    // Increments the strong counter unless the object is already dead (see WeakPtr::Lock).
+    bool TryIncStrongRefCnt() {
+        return strong_ref_cnt_.TryIncRef();
+    }
+
+    void DecStrongRefCnt() {
+        if (strong_ref_cnt_.DecRef() == 0) {
+            ReleaseObject();
+        }
+    }
+
+    bool IsImmortal() const {
+        return strong_ref_cnt_.IsImmortal();
+    }
+
+    size_t GetStrongRefCnt() const {
+        return strong_ref_cnt_.RefCount();
+    }
+
+    void IncWeakRefCnt() {
+        if (IsImmortal()) {
+            return;
+        }
+        weak_ref_cnt_.IncRef();
+    }
+
+    void DecWeakRefCnt() {
+        if (IsImmortal()) {
+            return;
+        }
+        if (weak_ref_cnt_.DecRef() == 0) {
+            ReleaseBlock();
+        }
+    }
+
+    // Weak references held by WeakPtr-s.
+    size_t GetWeakRefCnt() const {
+        return weak_ref_cnt_.RefCount() - (GetStrongRefCnt() != 0);
+    }
+
+    // The strong counter dropped to zero: destroy the object, then call ObjectDestroyed().
+    virtual void ReleaseObject() = 0;
+
+    // Nothing references the block any more.
+    virtual void ReleaseBlock() = 0;
+
+    void ObjectDestroyed() {
+#if SMART_PTRS_CHECK_BORROWS
+        ++generation_;
+#endif
+        if constexpr (Policy::kWeak) {
+            DecWeakRefCnt();
+        } else {
+            ReleaseBlock();
+        }
+    }
+
+    Counter strong_ref_cnt_;
+    [[no_unique_address]] std::conditional_t<Policy::kWeak, Counter, NoWeakCounter> weak_ref_cnt_;
+#if SMART_PTRS_CHECK_BORROWS
+    size_t generation_ = 0;
+#endif
+};
+
+template <typename T, typename Policy, typename Reclaim = ReclaimNow>
+struct ControlBlockNew : ControlBlockBase<Policy> {
+    ControlBlockNew(T* ptr) : ptr_(ptr) {
+    }
+
+    static void* operator new(size_t size) {
+        return Policy::BlockAllocator::Allocate(size);
+    }
+    static void operator delete(void* block, size_t size) {
+        Policy::BlockAllocator::Deallocate(block, size);
+    }
+
+    void ReleaseObject() override {
+        Reclaim::Retire(this, &DestroyObject);
+    }
+
+    void ReleaseBlock() override {
+        Reclaim::Retire(this, &DeleteBlock);
+    }
+
+    static void DestroyObject(void* block) {
+        auto self = static_cast<ControlBlockNew*>(block);
+        Policy::Deleter::Destroy(self->ptr_);
+        self->ObjectDestroyed();
+    }
+    static void DeleteBlock(void* block) {
+        delete static_cast<ControlBlockNew*>(block);
+    }
+
+    T* ptr_;
+};
+
+// Tag of ControlBlockMakeShared: the object is the result of `factory()`, constructed
+// right in the block without a move.
+struct FromFactory {};
+
+template <typename T, typename Policy, typename Reclaim = ReclaimNow,
+          typename Layout = CompactLayout>
+struct ControlBlockMakeShared : ControlBlockBase<Policy> {
+    template <typename... Args>
+    ControlBlockMakeShared(T*& ptr, Args&&... args) {
+        new (&buffer) T(std::forward<Args>(args)...);
+        ptr = reinterpret_cast<T*>(&buffer);
+    }
+    template <typename Factory>
+    ControlBlockMakeShared(T*& ptr, FromFactory, Factory&& factory) {
+        new (&buffer) T(factory());
+        ptr = reinterpret_cast<T*>(&buffer);
+    }
+
+    void ReleaseObject() override {
+        Reclaim::Retire(this, &DestroyObject);
+    }
+
+    void ReleaseBlock() override {
+        Reclaim::Retire(this, &DeleteBlock);
+    }
+
+    static void DestroyObject(void* block) {
+        auto self = static_cast<ControlBlockMakeShared*>(block);
+        auto temp_ptr = reinterpret_cast<T*>(&self->buffer);
+        temp_ptr->~T();
+        self->ObjectDestroyed();
+    }
+    static void DeleteBlock(void* block) {
+        delete static_cast<ControlBlockMakeShared*>(block);
+    }
+
+    alignas(Layout::template kObjectAlignment<T>) char buffer[sizeof(T)];
+};
+
+// Control block and object in static storage, e.g. for global constants.
+// Never counted, never destroyed.
+template <typename T, typename Policy>
+struct ControlBlockImmortal : ControlBlockBase<Policy> {
+    template <typename... Args>
+    ControlBlockImmortal(Args&&... args) {
+        new (&buffer) T(std::forward<Args>(args)...);
+        this->strong_ref_cnt_.MakeImmortal();
+    }
+
+    void ReleaseObject() override {
+    }
+
+    void ReleaseBlock() override {
+    }
+
+    T* Object() {
+        return std::launder(reinterpret_cast<T*>(&buffer));
+    }
+
+    alignas(T) char buffer[sizeof(T)];
+};
+
+// Counters of one object of a MakeSharedBatch allocation. The allocation is laid out
+// as Header | ControlBlockBatch[size] | T[size]: all counters of the batch form one
+// dense table, and the objects follow it. An object dies with its own strong count;
+// the allocation is freed when the last block of the batch is released.
+template <typename T, typename Policy>
+struct ControlBlockBatch : ControlBlockBase<Policy> {
+    struct Header {
+        std::atomic<size_t> live_blocks;
+        size_t size;
+    };
+
+    static constexpr size_t kAlignment =
+        std::max({alignof(Header), alignof(ControlBlockBatch), alignof(T)});
+    static constexpr size_t kBlocksOffset =
+        (sizeof(Header) + alignof(ControlBlockBatch) - 1) / alignof(ControlBlockBatch) *
+        alignof(ControlBlockBatch);
+
+    static size_t ObjectsOffset(size_t size) {
+        size_t end = kBlocksOffset + size * sizeof(ControlBlockBatch);
+        return (end + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+    static size_t AllocationSize(size_t size) {
+        return ObjectsOffset(size) + size * sizeof(T);
+    }
+
+    explicit ControlBlockBatch(Header* header) : header_(header) {
+    }
+
+    ControlBlockBatch* First() const {
+        return reinterpret_cast<ControlBlockBatch*>(reinterpret_cast<char*>(header_) +
+                                                    kBlocksOffset);
+    }
+    T* Object() const {
+        char* objects = reinterpret_cast<char*>(header_) + ObjectsOffset(header_->size);
+        return std::launder(reinterpret_cast<T*>(objects) + (this - First()));
+    }
+
+    void ReleaseObject() override {
+        Object()->~T();
+        this->ObjectDestroyed();
+    }
+
+    void ReleaseBlock() override {
+        if (header_->live_blocks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ::operator delete(header_, std::align_val_t(kAlignment));
+        }
+    }
+
+    Header* header_;
+};
+
+}  // namespace core
+
+class EnableSharedFromThisBase {};
+
+template <typename T, typename Policy = SharedPolicy>
+class EnableSharedFromThis;
+
+template <typename T, typename Policy>
+class SharedPtr {
+    template <typename Y, typename P>
+    friend class SharedPtr;
+
+    template <typename Y, typename P>
+    friend class WeakPtr;
+
+    template <typename Y>
+    friend class BorrowedPtr;
+
+public:
+    using ControlBlock = core::ControlBlockBase<Policy>;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // All template shit:
+
+    template <typename Y>
+    SharedPtr(const SharedPtr<Y, Policy>& other) {
+        block_ = other.block_;
+        ptr_ = other.ptr_;
+        if (block_) {
+            block_->IncStrongRefCnt();
+        }
+    }
+    template <typename Y>
+    SharedPtr(SharedPtr<Y, Policy>&& other) {
+        block_ = other.block_;
+        ptr_ = other.ptr_;
+        other.block_ = nullptr;
+        other.ptr_ = nullptr;
+    }
+
+    template <typename Y>
+    SharedPtr& operator=(const SharedPtr<Y, Policy>& other) {
+        if (block_) {
+            block_->DecStrongRefCnt();
+        }
+        if (ptr_ != other.ptr_) {
+            block_ = other.block_;
+            ptr_ = other.ptr_;
+            if (block_) {
+                block_->IncStrongRefCnt();
+            }
+        }
+        return *this;
+    }
+    template <typename Y>
+    SharedPtr& operator=(SharedPtr<Y, Policy>&& other) {
+        if (ptr_ != other.ptr_) {
+            if (block_) {
+                block_->DecStrongRefCnt();
+            }
+            block_ = other.block_;
+            ptr_ = other.ptr_;
+            other.block_ = nullptr;
+            other.ptr_ = nullptr;
+        }
+        return *this;
+    }
+
+    // MakeSharedConstructor
+
+    // Takes a new strong reference to `block`. `init_weak_this` binds EnableSharedFromThis
+    // of a freshly created object.
+    SharedPtr(ControlBlock* block, T* ptr, bool init_weak_this = false)
+        : block_(block), ptr_(ptr) {
+        block_->IncStrongRefCnt();
+        if (init_weak_this) {
+            InitWeakThis();
+        }
+    }
+
+    // Constructors
+
+    SharedPtr() {
+    }
+    SharedPtr(std::nullptr_t) {
+    }
+    template <typename Y>
+    explicit SharedPtr(Y* ptr) {
+        block_ = new core::ControlBlockNew<Y, Policy>(ptr);
+        block_->IncStrongRefCnt();
+        ptr_ = ptr;
+        InitWeakThis();
+    }
+
+    SharedPtr(const SharedPtr& other) {
+        block_ = other.block_;
+        ptr_ = other.ptr_;
+        if (block_) {
+            block_->IncStrongRefCnt();
+        }
+    }
+    SharedPtr(SharedPtr&& other) {
+        block_ = other.block_;
+        ptr_ = other.ptr_;
+        other.block_ = nullptr;
+        other.ptr_ = nullptr;
+    }
+
+    // Aliasing constructor
+    // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    template <typename Y>
+    SharedPtr(const SharedPtr<Y, Policy>& other, T* ptr) {
+        block_ = other.block_;
+        ptr_ = ptr;
+        if (block_) {
+            block_->IncStrongRefCnt();
+        }
+    }
+
+    // Promote `WeakPtr`
+    // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    explicit SharedPtr(const WeakPtr<T, Policy>& other) {
+        operator=(other.Lock());
+        if (!block_) {
+            throw BadWeakPtr();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SharedPtr& operator=(const SharedPtr& other) {
+        if (this != &other) {
+            if (block_) {
+                block_->DecStrongRefCnt();
+            }
+            block_ = other.block_;
+            ptr_ = other.ptr_;
+            if (block_) {
+                block_->IncStrongRefCnt();
+            }
+        }
+        return *this;
+    }
+    SharedPtr& operator=(SharedPtr&& other) {
+        if (this != &other) {
+            if (block_) {
+                block_->DecStrongRefCnt();
+            }
+            block_ = other.block_;
+            ptr_ = other.ptr_;
+            other.block_ = nullptr;
+            other.ptr_ = nullptr;
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedPtr() {
+        if (block_) {
+            block_->DecStrongRefCnt();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (block_) {
+            block_->DecStrongRefCnt();
+            block_ = nullptr;
+            ptr_ = nullptr;
+        }
+    }
+
+    template <typename Y>
+    void Reset(Y* ptr) {
+        if (block_) {
+            block_->DecStrongRefCnt();
+        }
+        block_ = new core::ControlBlockNew<Y, Policy>(ptr);
+        ptr_ = ptr;
+        block_->IncStrongRefCnt();
+        InitWeakThis();
+    }
+    void Swap(SharedPtr& other) {
+        std::swap(*this, other);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator*() const {
+        return *ptr_;
+    }
+    T* operator->() const {
+        return ptr_;
+    }
+    size_t UseCount() const {
+        if (block_) {
+            return block_->GetStrongRefCnt();
+        }
+        return 0;
+    }
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+private:
+    void InitWeakThis() {
+        if constexpr (Policy::kWeak && std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
+            InitWeakThis(ptr_);
+        }
+    }
+    template <typename Y>
+    void InitWeakThis(EnableSharedFromThis<Y, Policy>* esft_ptr) {
+        esft_ptr->weak_this_ = *this;
+    }
+
+    ControlBlock* block_ = nullptr;
+    T* ptr_ = nullptr;
+};
+
+template <typename T, typename U, typename Policy>
+inline bool operator==(const SharedPtr<T, Policy>& left, const SharedPtr<U, Policy>& right) {
+    return left.Get() == right.Get();
+}
+
+// Look for usage examples in tests
+template <typename T, typename Policy>
+class EnableSharedFromThis : public EnableSharedFromThisBase {
+    static_assert(Policy::kWeak, "EnableSharedFromThis requires WeakPtr support");
+
+    template <typename Y, typename P>
+    friend class SharedPtr;
+
+public:
+    SharedPtr<T, Policy> SharedFromThis() {
+        return SharedPtr<T, Policy>(weak_this_);
+    }
+    SharedPtr<const T, Policy> SharedFromThis() const {
+        return SharedPtr<T, Policy>(weak_this_);
+    }
+
+    WeakPtr<T, Policy> WeakFromThis() noexcept {
+        return weak_this_;
+    }
+    WeakPtr<const T, Policy> WeakFromThis() const noexcept {
+        return weak_this_;
+    }
+
+private:
+    WeakPtr<T, Policy> weak_this_;
+};
+
+namespace core {
+
+template <typename T, typename Policy, typename Layout = CompactLayout, typename... Args>
+SharedPtr<T, Policy> MakeShared(Args&&... args) {
+    T* ptr = nullptr;
+    // The block sets `ptr`, so it has to be created before `ptr` is read.
+    auto block = new ControlBlockMakeShared<T, Policy, ReclaimNow, Layout>(
+        ptr, std::forward<Args>(args)...);
+    return SharedPtr<T, Policy>(block, ptr, true);
+}
+
+template <typename T, typename Policy, typename... Args>
+std::vector<SharedPtr<T, Policy>> MakeSharedBatch(size_t size, const Args&... args) {
+    using Block = ControlBlockBatch<T, Policy>;
+    std::vector<SharedPtr<T, Policy>> result;
+    if (size == 0) {
+        return result;
+    }
+    result.reserve(size);
+
+    void* memory = ::operator new(Block::AllocationSize(size), std::align_val_t(Block::kAlignment));
+    auto header = new (memory) typename Block::Header{{size}, size};
+    auto blocks = reinterpret_cast<Block*>(static_cast<char*>(memory) + Block::kBlocksOffset);
+    auto objects = reinterpret_cast<T*>(static_cast<char*>(memory) + Block::ObjectsOffset(size));
+    size_t constructed = 0;
+    try {
+        for (; constructed < size; ++constructed) {
+            new (objects + constructed) T(args...);
+        }
+    } catch (...) {
+        while (constructed > 0) {
+            objects[--constructed].~T();
+        }
+        ::operator delete(memory, std::align_val_t(Block::kAlignment));
+        throw;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        auto block = new (blocks + i) Block(header);
+        result.emplace_back(block, block->Object(), true);
+    }
+    return result;
+}
+
+}  // namespace core
+
+// Allocate memory only once
+// `MakeShared<T, CacheLinePadded<>>(args...)` for objects copied from many threads.
+template <typename T, typename Layout = CompactLayout, typename... Args>
+SharedPtr<T> MakeShared(Args&&... args) {
+    return core::MakeShared<T, SharedPolicy, Layout>(std::forward<Args>(args)...);
+}
+
+// `size` objects constructed from the same `args`, each owned by its own SharedPtr,
+// in a single allocation (see ControlBlockBatch).
+template <typename T, typename... Args>
+std::vector<SharedPtr<T>> MakeSharedBatch(size_t size, const Args&... args) {
+    return core::MakeSharedBatch<T, SharedPolicy>(size, args...);
+}
+
+// Usage: `static ImmortalShared<std::string> kEmpty; SharedPtr<std::string> p = kEmpty.Get();`
+template <typename T, typename Policy = SharedPolicy>
+class ImmortalShared {
+public:
+    template <typename... Args>
+    explicit ImmortalShared(Args&&... args) : block_(std::forward<Args>(args)...) {
+        // Binds `weak_this_` for types with EnableSharedFromThis.
+        SharedPtr<T, Policy> self(&block_, block_.Object(), true);
+    }
+
+    ImmortalShared(const ImmortalShared& other) = delete;
+    ImmortalShared& operator=(const ImmortalShared& other) = delete;
+
+    SharedPtr<T, Policy> Get() {
+        return SharedPtr<T, Policy>(&block_, block_.Object());
+    }
+
+private:
+    core::ControlBlockImmortal<T, Policy> block_;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <exception>
+
+// Instead of std::bad_weak_ptr
+class BadWeakPtr : public std::exception {};
+
+// Default policy of SharedPtr / WeakPtr. Every module built on the core (shared/,
+// weak/, shared-from-this/) defines its own, see core/shared.h.
+struct SharedPolicy;
+
+template <typename T, typename Policy = SharedPolicy>
+class SharedPtr;
+
+template <typename T, typename Policy = SharedPolicy>
+class WeakPtr;
+
+template <typename T>
+class BorrowedPtr;
@@ -0,0 +1,97 @@
+#include "file_heap.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Startup time: rebuilding a search tree from its source data (a list of keys)
+// against reopening the heap file. Run with `test_file_heap [bench]`.
+
+namespace {
+
+constexpr int kKeys = 1 << 20;
+
+struct Tag;
+using Heap = FileHeap<Tag, 2>;
+
+struct Node : RefCounted<Node, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {
+    explicit Node(uint32_t key) : key(key) {
+    }
+
+    uint32_t key;
+    CompressedIntrusivePtr<Node, Heap> left;
+    CompressedIntrusivePtr<Node, Heap> right;
+};
+
+using NodePtr = CompressedIntrusivePtr<Node, Heap>;
+
+double Seconds(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+NodePtr Build(Heap& heap, const std::vector<uint32_t>& keys) {
+    NodePtr root;
+    for (uint32_t key : keys) {
+        NodePtr* slot = &root;
+        while (*slot) {
+            slot = key < (*slot)->key ? &(*slot)->left : &(*slot)->right;
+        }
+        *slot = heap.MakeIntrusive<Node>(key);
+    }
+    return root;
+}
+
+bool Contains(const NodePtr& root, uint32_t key) {
+    const Node* node = root.Get();
+    while (node && node->key != key) {
+        node = (key < node->key ? node->left : node->right).Get();
+    }
+    return node;
+}
+
+}  // namespace
+
+TEST_CASE("Warm restart", "[.bench]") {
+    std::string path = "/tmp/smart_ptrs_heap_bench_" + std::to_string(getpid());
+    std::remove(path.c_str());
+    size_t capacity = size_t{64} << 20;
+
+    std::mt19937 gen(42);
+    std::vector<uint32_t> keys(kKeys);
+    for (auto& key : keys) {
+        key = gen();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    {
+        Heap heap(path, capacity);
+        heap.SetRoot(Build(heap, keys));
+        REQUIRE(Contains(heap.Root<Node>(), keys.back()));
+    }
+    double rebuild = Seconds(begin);
+
+    begin = std::chrono::steady_clock::now();
+    {
+        Heap heap(path, capacity);
+        REQUIRE(heap.Restored());
+        REQUIRE(Contains(heap.Root<Node>(), keys.back()));
+        double first_lookup = Seconds(begin);
+
+        int found = 0;
+        auto root = heap.Root<Node>();
+        for (int i = 0; i < kKeys; i += 64) {
+            found += Contains(root, keys[i]);
+        }
+        REQUIRE(found == (kKeys + 63) / 64);
+        std::cout << "rebuild + close " << rebuild << " s\treopen + first lookup " << first_lookup
+                  << " s\treopen + " << kKeys / 64 << " lookups " << Seconds(begin) << " s\n";
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <compressed/compressed.h>
+#include <core/granule_heap.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Persistent heap: RefCounted objects in a memory-mapped file, linked by
+// CompressedIntrusivePtr offsets. A restarted process maps the file and uses the
+// graph at once, without deserializing anything.
+//
+// FileHeap<Tag, Shift> has the interface of OffsetArena, so objects are declared the
+// same way and the file spans up to 2^(32 + Shift) bytes:
+//
+//     struct Tag;
+//     using Heap = FileHeap<Tag>;
+//     struct Node : RefCounted<Node, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {
+//         CompressedIntrusivePtr<Node, Heap> left, right;
+//     };
+//
+// Objects must not hold absolute addresses or a vptr (no std::string, no virtual
+// functions). The heap is not thread-safe.
+//
+// Shutdown protocol. The header has a `clean` flag. Opening a file clears the flag
+// and syncs the header before anything else is written; Close() (or the destructor)
+// syncs the data, then sets the flag and syncs the header again. A file left by a
+// crashed process is not clean: it is reset to an empty heap and Restored() is
+// false, so the caller rebuilds from its source data. Flush() syncs the data of a
+// running heap, e.g. to bound the work the OS has to do at Close().
+//
+// Only the root and links between objects may hold references at Close(): pointers
+// outside the heap have to be gone, or their references stay in the file forever.
+template <typename Tag, size_t Shift = 3>
+class FileHeap {
+public:
+    static constexpr size_t kGranule = size_t{1} << Shift;
+    static constexpr size_t kMaxCapacity = kGranule << 32;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    // Opens `path`, creating it if needed. The file grows to `capacity` bytes (sparse)
+    // if it is smaller, and never shrinks.
+    FileHeap(const std::string& path, size_t capacity) {
+        assert(!instance_ && "Only one FileHeap of a type at a time");
+        int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) == -1) {
+            Fail(fd, "fstat");
+        }
+        size_t old_size = info.st_size;
+        size_t size = std::max(RoundUp(capacity, kPageSize), old_size);
+        if (size > kMaxCapacity || size < RoundUp(sizeof(Header), kGranule) + kGranule) {
+            close(fd);
+            throw std::invalid_argument("Bad FileHeap capacity");
+        }
+        if (size > old_size && ftruncate(fd, size) == -1) {
+            Fail(fd, "ftruncate");
+        }
+        void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            Fail(fd, "mmap");
+        }
+        close(fd);
+
+        base_ = static_cast<char*>(address);
+        size_ = size;
+        instance_ = this;
+        header_ = static_cast<Header*>(address);
+        restored_ = old_size >= sizeof(Header) && header_->magic == kMagic &&
+                    header_->shift == Shift && header_->clean;
+        if (!restored_) {
+            header_ = new (base_) Header;
+            header_->heap.used = RoundUp(sizeof(Header), kGranule) >> Shift;
+        }
+        header_->clean = 0;
+        SyncHeader();
+    }
+
+    FileHeap(const FileHeap& other) = delete;
+    FileHeap& operator=(const FileHeap& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~FileHeap() {
+        if (base_) {
+            Close();
+        }
+    }
+
+    // Syncs the heap, marks it clean and unmaps it.
+    void Close() {
+        Flush();
+        header_->clean = 1;
+        SyncHeader();
+        munmap(base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+        instance_ = nullptr;
+    }
+
+    // Writes the used part of the heap to the file.
+    void Flush() {
+        if (msync(base_, std::min(RoundUp(UsedBytes(), kPageSize), size_), MS_SYNC) == -1) {
+            throw std::system_error(errno, std::generic_category(), "msync");
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Arena interface (see OffsetArena)
+
+    static FileHeap& Instance() {
+        return *instance_;
+    }
+
+    static uint32_t Encode(const void* ptr) {
+        if (!ptr) {
+            return 0;
+        }
+        return static_cast<uint32_t>((static_cast<const char*>(ptr) - base_) >> Shift);
+    }
+    // `offset` must not be 0.
+    template <typename T>
+    static T* Decode(uint32_t offset) {
+        return reinterpret_cast<T*>(base_ + (size_t{offset} << Shift));
+    }
+
+    // Throws std::bad_alloc when the file is full.
+    void* Allocate(size_t size) {
+        return header_->heap.Allocate(base_, size_ >> Shift, size);
+    }
+    void Deallocate(void* block, size_t size) {
+        header_->heap.Deallocate(base_, block, size);
+    }
+
+    template <typename T, typename... Args>
+    CompressedUniquePtr<T, FileHeap> MakeUnique(Args&&... args) {
+        return CompressedUniquePtr<T, FileHeap>(Construct<T>(std::forward<Args>(args)...));
+    }
+    // T is RefCounted with OffsetArenaDelete<FileHeap>.
+    template <typename T, typename... Args>
+    CompressedIntrusivePtr<T, FileHeap> MakeIntrusive(Args&&... args) {
+        return CompressedIntrusivePtr<T, FileHeap>(Construct<T>(std::forward<Args>(args)...));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Root
+
+    // The entry point into the graph after a restart. Throws std::logic_error if the
+    // stored root has another type.
+    template <typename T>
+    CompressedIntrusivePtr<T, FileHeap> Root() const {
+        if (!header_->root) {
+            return nullptr;
+        }
+        CheckRootType<T>();
+        return CompressedIntrusivePtr<T, FileHeap>(Decode<T>(header_->root));
+    }
+    template <typename T>
+    void SetRoot(const CompressedIntrusivePtr<T, FileHeap>& root) {
+        if (header_->root) {
+            CheckRootType<T>();
+        }
+        // Keeps the old root alive until the new one is set.
+        auto old = Root<T>();
+        if (root) {
+            root->IncRef();
+        }
+        if (header_->root) {
+            Decode<T>(header_->root)->DecRef();
+        }
+        header_->root = root.Offset();
+        header_->root_type = core::TypeKey<T>();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // True if the heap was opened from a cleanly closed file.
+    bool Restored() const {
+        return restored_;
+    }
+    size_t LiveObjects() const {
+        return header_->heap.live;
+    }
+    size_t UsedBytes() const {
+        return header_->heap.used << Shift;
+    }
+    size_t Capacity() const {
+        return size_;
+    }
+
+private:
+    static constexpr uint64_t kMagic = 0x50484541504d4d32;  // "PHEAPMM2"
+    static constexpr size_t kPageSize = 4096;
+
+    struct Header {
+        uint64_t magic = kMagic;
+        uint64_t shift = Shift;
+        uint64_t clean = 0;
+        uint64_t root = 0;
+        uint64_t root_type = 0;
+        core::GranuleHeap<uint32_t, Shift> heap;
+    };
+
+    static size_t RoundUp(size_t size, size_t alignment) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    [[noreturn]] static void Fail(int fd, const char* what) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), what);
+    }
+
+    template <typename T>
+    void CheckRootType() const {
+        if (header_->root_type != core::TypeKey<T>()) {
+            throw std::logic_error("FileHeap root has another type");
+        }
+    }
+
+    void SyncHeader() {
+        if (msync(base_, kPageSize, MS_SYNC) == -1) {
+            throw std::system_error(errno, std::generic_category(), "msync");
+        }
+    }
+
+    template <typename T, typename... Args>
+    T* Construct(Args&&... args) {
+        static_assert(!std::is_polymorphic_v<T>, "A vptr does not survive a restart");
+        static_assert(alignof(T) <= kGranule, "Objects must fit the granule alignment");
+        void* block = Allocate(sizeof(T));
+        try {
+            return new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(block, sizeof(T));
+            throw;
+        }
+    }
+
+    static_assert(sizeof(Header) <= kPageSize);
+
+    static inline char* base_ = nullptr;
+    static inline size_t size_ = 0;
+    static inline FileHeap* instance_ = nullptr;
+
+    Header* header_ = nullptr;
+    bool restored_ = false;
+};
@@ -0,0 +1,150 @@
+#include "file_heap.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tag;
+using Heap = FileHeap<Tag>;
+
+struct Node : RefCounted<Node, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {
+    explicit Node(int value) : value(value) {
+    }
+
+    int value;
+    CompressedIntrusivePtr<Node, Heap> next;
+};
+
+using NodePtr = CompressedIntrusivePtr<Node, Heap>;
+
+constexpr size_t kCapacity = 1 << 20;
+
+struct TempFile {
+    TempFile() : path("/tmp/smart_ptrs_heap_" + std::to_string(getpid())) {
+        std::remove(path.c_str());
+    }
+    ~TempFile() {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+
+NodePtr MakeList(Heap& heap, int length) {
+    NodePtr head;
+    for (int i = length; i > 0; --i) {
+        auto node = heap.MakeIntrusive<Node>(i);
+        node->next = head;
+        head = node;
+    }
+    return head;
+}
+
+int Sum(const NodePtr& head) {
+    int sum = 0;
+    for (Node* node = head.Get(); node; node = node->next.Get()) {
+        sum += node->value;
+    }
+    return sum;
+}
+
+}  // namespace
+
+TEST_CASE("Graph survives a restart") {
+    TempFile file;
+    {
+        Heap heap(file.path, kCapacity);
+        REQUIRE(!heap.Restored());
+        heap.SetRoot(MakeList(heap, 100));
+        REQUIRE(heap.LiveObjects() == 100);
+    }
+    {
+        Heap heap(file.path, kCapacity);
+        REQUIRE(heap.Restored());
+        REQUIRE(heap.LiveObjects() == 100);
+        auto root = heap.Root<Node>();
+        REQUIRE(Sum(root) == 5050);
+        REQUIRE(root.UseCount() == 2);
+
+        // Drop the first half of the list.
+        auto middle = root;
+        for (int i = 0; i < 50; ++i) {
+            middle = middle->next;
+        }
+        heap.SetRoot(middle);
+        root.Reset();
+        middle.Reset();
+        REQUIRE(heap.LiveObjects() == 50);
+    }
+    {
+        Heap heap(file.path, kCapacity);
+        REQUIRE(heap.Restored());
+        REQUIRE(Sum(heap.Root<Node>()) == 5050 - 1275);
+
+        // Free lists survive too.
+        size_t used = heap.UsedBytes();
+        auto node = heap.MakeIntrusive<Node>(0);
+        REQUIRE(heap.UsedBytes() == used);
+    }
+}
+
+TEST_CASE("Growing the file") {
+    TempFile file;
+    {
+        Heap heap(file.path, kCapacity);
+        heap.SetRoot(MakeList(heap, 10));
+    }
+    {
+        Heap heap(file.path, 4 * kCapacity);
+        REQUIRE(heap.Restored());
+        REQUIRE(heap.Capacity() == 4 * kCapacity);
+        REQUIRE(Sum(heap.Root<Node>()) == 55);
+    }
+    {
+        Heap heap(file.path, kCapacity);
+        REQUIRE(heap.Capacity() == 4 * kCapacity);
+    }
+}
+
+TEST_CASE("Root type is checked") {
+    struct Other : RefCounted<Other, NarrowCounter<uint32_t>, OffsetArenaDelete<Heap>> {};
+
+    TempFile file;
+    Heap heap(file.path, kCapacity);
+    heap.SetRoot(heap.MakeIntrusive<Node>(1));
+    REQUIRE_THROWS_AS(heap.Root<Other>(), std::logic_error);
+    heap.SetRoot(NodePtr());
+}
+
+TEST_CASE("Crashed process leaves a dirty file") {
+    TempFile file;
+    {
+        Heap heap(file.path, kCapacity);
+        heap.SetRoot(MakeList(heap, 3));
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        Heap heap(file.path, kCapacity);
+        heap.SetRoot(MakeList(heap, 5));
+        heap.Flush();
+        _exit(heap.Restored() ? 0 : 1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+
+    Heap heap(file.path, kCapacity);
+    REQUIRE(!heap.Restored());
+    REQUIRE(heap.LiveObjects() == 0);
+    REQUIRE(!heap.Root<Node>());
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Atomic slot for IntrusivePtr<T>.
+//
+// The slot keeps a single 64-bit word: the pointer in the low 48 bits and a local
+// (external) counter in the high 16 bits. On Store the writer prepays kBatch extra
+// references in the object itself, so a reader only has to bump the local counter
+// with one fetch_add to take one of them: it never touches the object's counter on
+// the fast path. When the local counter crosses kRefill, the reader that noticed it
+// moves the consumed references back into the object and resets the local counter.
+// A writer that replaces the pointer returns the unused part of the batch.
+//
+// T must be RefCounted with a thread-safe counter (see AtomicRefCounted).
+// Assumes user-space pointers fit in 48 bits and fewer than kRefill readers
+// race on one slot at the same moment.
+template <typename T>
+class AtomicIntrusivePtr {
+    static_assert(sizeof(void*) == sizeof(uint64_t), "Requires 64-bit pointers");
+
+    static constexpr int kPtrBits = 48;
+    static constexpr uint64_t kPtrMask = (uint64_t{1} << kPtrBits) - 1;
+    static constexpr uint64_t kOneLocal = uint64_t{1} << kPtrBits;
+
+public:
+    static constexpr size_t kBatch = size_t{1} << 15;
+    static constexpr size_t kRefill = kBatch / 2;
+
+    // Constructors
+
+    AtomicIntrusivePtr() {
+    }
+    AtomicIntrusivePtr(std::nullptr_t) {
+    }
+    AtomicIntrusivePtr(IntrusivePtr<T> desired) : word_(Prepare(std::move(desired))) {
+    }
+
+    AtomicIntrusivePtr(const AtomicIntrusivePtr& other) = delete;
+    AtomicIntrusivePtr& operator=(const AtomicIntrusivePtr& other) = delete;
+
+    // Destructor
+
+    ~AtomicIntrusivePtr() {
+        Release(word_.load(std::memory_order_acquire), true);
+    }
+
+    // Operations
+
+    IntrusivePtr<T> Load() const {
+        uint64_t word = word_.fetch_add(kOneLocal, std::memory_order_acq_rel);
+        T* ptr = GetPtr(word);
+        if (GetLocal(word) + 1 >= kRefill) {
+            Refill(ptr);
+        }
+        IntrusivePtr<T> result;
+        result.ptr_ = ptr;
+        return result;
+    }
+
+    void Store(IntrusivePtr<T> desired) {
+        Exchange(std::move(desired));
+    }
+
+    IntrusivePtr<T> Exchange(IntrusivePtr<T> desired) {
+        uint64_t old = word_.exchange(Prepare(std::move(desired)), std::memory_order_acq_rel);
+        Release(old, false);
+        IntrusivePtr<T> result;
+        result.ptr_ = GetPtr(old);
+        return result;
+    }
+
+    // Replaces the value if the slot still points to `expected`.
+    // On failure `expected` receives the current value.
+    bool CompareExchange(IntrusivePtr<T>& expected, IntrusivePtr<T> desired) {
+        uint64_t new_word = Prepare(std::move(desired));
+        uint64_t cur = word_.load(std::memory_order_acquire);
+        while (GetPtr(cur) == expected.Get()) {
+            if (word_.compare_exchange_weak(cur, new_word, std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+                Release(cur, true);
+                return true;
+            }
+        }
+        Release(new_word, true);
+        expected = Load();
+        return false;
+    }
+
+    bool IsLockFree() const {
+        return word_.is_lock_free();
+    }
+
+private:
+    static T* GetPtr(uint64_t word) {
+        return reinterpret_cast<T*>(word & kPtrMask);
+    }
+
+    static size_t GetLocal(uint64_t word) {
+        return word >> kPtrBits;
+    }
+
+    // Takes over the reference of `desired` and prepays the batch.
+    static uint64_t Prepare(IntrusivePtr<T> desired) {
+        T* ptr = std::exchange(desired.ptr_, nullptr);
+        if (ptr) {
+            ptr->IncRef(kBatch);
+        }
+        return reinterpret_cast<uint64_t>(ptr);
+    }
+
+    // Gives back what is left from the batch of an unpublished word,
+    // plus the slot's own reference if `drop_own` is set.
+    static void Release(uint64_t word, bool drop_own) {
+        T* ptr = GetPtr(word);
+        if (!ptr) {
+            return;
+        }
+        size_t unused = kBatch - GetLocal(word) + (drop_own ? 1 : 0);
+        if (unused != 0) {
+            ptr->DecRef(unused);
+        }
+    }
+
+    // Caller holds a reference to `ptr`, so it stays alive here.
+    void Refill(T* ptr) const {
+        uint64_t cur = word_.load(std::memory_order_acquire);
+        while (GetPtr(cur) == ptr && GetLocal(cur) >= kRefill) {
+            size_t used = GetLocal(cur);
+            if (ptr) {
+                ptr->IncRef(used);
+            }
+            if (word_.compare_exchange_weak(cur, reinterpret_cast<uint64_t>(ptr),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+                return;
+            }
+            if (ptr) {
+                ptr->DecRef(used);
+            }
+        }
+    }
+
+    mutable std::atomic<uint64_t> word_ = 0;
+};
@@ -0,0 +1,104 @@
+#include "atomic_intrusive.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Reader scaling: every thread takes snapshots of one hot slot while a writer
+// replaces it from time to time. Run with `test_intrusive [bench]`.
+
+namespace {
+
+struct Payload : AtomicRefCounted<Payload> {
+    Payload(int value) : value(value) {
+    }
+
+    int value;
+};
+
+constexpr int kLoadsPerThread = 1 << 20;
+
+template <typename Slot, typename LoadFn, typename StoreFn>
+double MeasureMops(int threads, Slot& slot, LoadFn load, StoreFn store) {
+    std::atomic<bool> start = false;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < threads; ++i) {
+        readers.emplace_back([&] {
+            while (!start.load()) {
+            }
+            int64_t sum = 0;
+            for (int j = 0; j < kLoadsPerThread; ++j) {
+                sum += load(slot);
+            }
+            (void)sum;
+        });
+    }
+    std::thread writer([&] {
+        for (int i = 0; !done.load(); ++i) {
+            store(slot, i);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    done = true;
+    writer.join();
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return threads * static_cast<double>(kLoadsPerThread) / seconds / 1e6;
+}
+
+struct LockedSlot {
+    std::mutex mutex;
+    IntrusivePtr<Payload> ptr;
+};
+
+}  // namespace
+
+TEST_CASE("AtomicIntrusivePtr reader scaling", "[.bench]") {
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "threads\tatomic_intrusive\tmutex_intrusive\tatomic<shared_ptr>  (Mloads/s)\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        AtomicIntrusivePtr<Payload> atomic_slot(MakeIntrusive<Payload>(0));
+        double atomic_mops = MeasureMops(
+            threads, atomic_slot, [](auto& slot) { return slot.Load()->value; },
+            [](auto& slot, int i) { slot.Store(MakeIntrusive<Payload>(i)); });
+
+        LockedSlot locked_slot;
+        locked_slot.ptr = MakeIntrusive<Payload>(0);
+        double locked_mops = MeasureMops(
+            threads, locked_slot,
+            [](auto& slot) {
+                IntrusivePtr<Payload> snapshot;
+                {
+                    std::lock_guard guard(slot.mutex);
+                    snapshot = slot.ptr;
+                }
+                return snapshot->value;
+            },
+            [](auto& slot, int i) {
+                auto fresh = MakeIntrusive<Payload>(i);
+                std::lock_guard guard(slot.mutex);
+                slot.ptr = std::move(fresh);
+            });
+
+        std::atomic<std::shared_ptr<int>> std_slot(std::make_shared<int>(0));
+        double std_mops = MeasureMops(
+            threads, std_slot, [](auto& slot) { return *slot.load(); },
+            [](auto& slot, int i) { slot.store(std::make_shared<int>(i)); });
+
+        std::cout << threads << '\t' << atomic_mops << "\t\t\t" << locked_mops << "\t\t\t"
+                  << std_mops << '\n';
+    }
+}
@@ -0,0 +1,76 @@
+#include "intrusive.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Density of a 10M-node graph depending on the counter policy.
+// Nodes live in one contiguous array, so the footprint is exactly N * sizeof(Node).
+// Run with `test_intrusive [bench]`.
+
+namespace {
+
+constexpr uint32_t kNumNodes = 10'000'000;
+constexpr int kSteps = 1 << 24;
+
+// Nodes are owned by the array, references only pin them.
+struct KeepAlive {
+    template <typename T>
+    static void Destroy(T*) {
+    }
+};
+
+template <typename Counter>
+struct GraphNode : RefCounted<GraphNode<Counter>, Counter, KeepAlive> {
+    uint32_t next = 0;
+    float weight = 1;
+    uint32_t id = 0;
+};
+
+struct TailPayload {
+    TailPayload() {
+    }
+
+    uint32_t next = 0;
+    float weight = 1;
+    uint16_t id = 0;
+};
+
+template <typename Node>
+void RunGraph(const char* name) {
+    std::vector<Node> nodes(kNumNodes);
+    std::mt19937 gen(42);
+    for (uint32_t i = 0; i < kNumNodes; ++i) {
+        nodes[i].next = gen() % kNumNodes;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    IntrusivePtr<Node> cur(&nodes[0]);
+    double sum = 0;
+    for (int i = 0; i < kSteps; ++i) {
+        sum += cur->weight;
+        cur = IntrusivePtr<Node>(&nodes[cur->next]);
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << name << "\tsizeof=" << sizeof(Node)
+              << "\tgraph=" << sizeof(Node) * kNumNodes / (1 << 20) << "MiB"
+              << "\twalk=" << seconds * 1e9 / kSteps << "ns/step\t(" << sum << ")\n";
+}
+
+}  // namespace
+
+TEST_CASE("Counter policies density", "[.bench]") {
+    RunGraph<GraphNode<SimpleCounter>>("SimpleCounter\t\t");
+    RunGraph<GraphNode<AtomicCounter>>("AtomicCounter\t\t");
+    RunGraph<GraphNode<NarrowCounter<uint32_t>>>("NarrowCounter<u32>\t");
+    RunGraph<GraphNode<AtomicStickyCounter<uint32_t>>>("AtomicSticky<u32>\t");
+    RunGraph<RefCountedTail<TailPayload, StickyCounter<uint16_t>, KeepAlive>>(
+        "Tail StickyCounter<u16>");
+    RunGraph<RefCountedTail<TailPayload, AtomicNarrowCounter<uint16_t>, KeepAlive>>(
+        "Tail AtomicNarrow<u16>\t");
+}
@@ -0,0 +1,63 @@
+#include "deferred.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Hot loop of short-lived copies of one shared object from every thread, flushed at
+// the end of each "request". Run with `test_intrusive [bench]`.
+
+namespace {
+
+struct Shared : AtomicRefCounted<Shared> {
+    int value = 1;
+};
+
+constexpr int kRequestsPerThread = 1 << 10;
+constexpr int kCopiesPerRequest = 1 << 10;
+
+template <typename Ptr, typename EndRequest>
+double MeasureMops(int threads, const Ptr& root, EndRequest end_request) {
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&] {
+            int64_t sum = 0;
+            for (int request = 0; request < kRequestsPerThread; ++request) {
+                for (int j = 0; j < kCopiesPerRequest; ++j) {
+                    Ptr copy = root;
+                    sum += copy->value;
+                }
+                end_request();
+            }
+            (void)sum;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return threads * static_cast<double>(kRequestsPerThread) * kCopiesPerRequest / seconds / 1e6;
+}
+
+}  // namespace
+
+TEST_CASE("DeferredPtr vs IntrusivePtr copies", "[.bench]") {
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "threads\tIntrusivePtr\tDeferredPtr  (Mcopies/s)\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        auto intrusive = MakeIntrusive<Shared>();
+        double intrusive_mops = MeasureMops(threads, intrusive, [] {});
+
+        DeferredPtr<Shared> deferred(intrusive);
+        double deferred_mops =
+            MeasureMops(threads, deferred, [] { DeferredDomain::Instance().Flush(); });
+
+        std::cout << threads << '\t' << intrusive_mops << "\t\t" << deferred_mops << '\n';
+    }
+    DeferredDomain::Instance().Drain();
+}
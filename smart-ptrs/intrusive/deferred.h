@@ -0,0 +1,338 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Deferred reference counting.
+//
+// DeferredPtr<T> does not touch the object's counter on copy and destruction: it
+// logs +1/-1 in a thread-local log where updates of one object are coalesced, so a
+// short-lived copy costs a hash map update and no shared write at all. The log is
+// applied by Flush(): at the end of a request or automatically every kFlushEvery ops.
+//
+// A decrement can only be applied after every increment that happened before it,
+// and that increment may still sit in another thread's log. Each logged update is
+// therefore tagged with the epoch its thread saw at its previous flush, and the
+// global epoch advances once every registered thread has flushed in the current one.
+// An increment that happened before a decrement tagged `e` is tagged at most `e + 1`,
+// so Flush() applies increments at once and keeps decrements tagged `e` until every
+// thread has flushed its `e + 1` updates. Objects are thus destroyed only after a
+// flush proves the count is zero.
+//
+// A registered thread that stops flushing stalls reclamation (not correctness);
+// threads unregister on exit after a final flush. Pointers released by thread_local
+// destructors after that update the counter directly (see LogEagerly). Decrements
+// still pending when the process exits are never applied.
+//
+// T must be RefCounted with a thread-safe counter (see AtomicRefCounted).
+class DeferredDomain {
+public:
+    static constexpr size_t kFlushEvery = 4096;
+
+    static DeferredDomain& Instance() {
+        static DeferredDomain domain;
+        return domain;
+    }
+
+    DeferredDomain(const DeferredDomain& other) = delete;
+    DeferredDomain& operator=(const DeferredDomain& other) = delete;
+
+    template <typename T>
+    void LogIncrement(T* object) {
+        Log(object, 1, &Inc<T>, &Dec<T>);
+    }
+    template <typename T>
+    void LogDecrement(T* object) {
+        Log(object, -1, &Inc<T>, &Dec<T>);
+    }
+
+    // Applies the calling thread's log: increments right away, decrements once it is
+    // safe. Destructors of released objects run on the calling thread.
+    void Flush() {
+        if (log_gone_) {
+            ApplyReady();
+            return;
+        }
+        FlushLog(Local());
+    }
+
+    // Flushes until every decrement logged so far is applied. Only returns once all
+    // other registered threads flush too (or exit).
+    void Drain() {
+        do {
+            Flush();
+        } while (PendingDecrements() != 0 || (!log_gone_ && !Local().entries.empty()));
+    }
+
+    size_t PendingDecrements() const {
+        std::lock_guard guard(mutex_);
+        return pending_.size();
+    }
+    uint64_t Epoch() const {
+        std::lock_guard guard(mutex_);
+        return epoch_;
+    }
+
+private:
+    using Apply = void (*)(void*, size_t);
+
+    struct Entry {
+        ptrdiff_t delta = 0;
+        Apply inc;
+        Apply dec;
+    };
+
+    struct Pending {
+        void* object;
+        size_t count;
+        Apply dec;
+        uint64_t epoch;
+    };
+
+    struct ThreadLog {
+        explicit ThreadLog(DeferredDomain* domain) : domain(domain) {
+            std::lock_guard guard(domain->mutex_);
+            epoch = domain->epoch_;
+            domain->logs_.push_back(this);
+        }
+
+        ~ThreadLog() {
+            while (!entries.empty()) {
+                domain->FlushLog(*this);
+            }
+            // From here on the thread updates counters without a log.
+            log_gone_ = true;
+            std::lock_guard guard(domain->mutex_);
+            std::erase(domain->logs_, this);
+        }
+
+        DeferredDomain* domain;
+        std::unordered_map<void*, Entry> entries;
+        // Hot loops usually hit the same object over and over.
+        void* last_object = nullptr;
+        Entry* last_entry = nullptr;
+        size_t ops = 0;
+        uint64_t epoch;
+        bool flushing = false;
+    };
+
+    DeferredDomain() {
+    }
+
+    void FlushLog(ThreadLog& log) {
+        if (log.flushing) {
+            return;
+        }
+        log.flushing = true;
+        std::unordered_map<void*, Entry> entries;
+        entries.swap(log.entries);
+        log.last_object = nullptr;
+        log.ops = 0;
+
+        std::vector<Pending> ready;
+        {
+            std::lock_guard guard(mutex_);
+            for (const auto& [object, entry] : entries) {
+                if (entry.delta > 0) {
+                    entry.inc(object, entry.delta);
+                } else if (entry.delta < 0) {
+                    pending_.push_back({object, static_cast<size_t>(-entry.delta), entry.dec,
+                                        log.epoch});
+                }
+            }
+            log.epoch = epoch_;
+            TakeReady(&ready);
+        }
+        // Outside of the lock: destructors may log and flush again.
+        for (const auto& pending : ready) {
+            pending.dec(pending.object, pending.count);
+        }
+        log.flushing = false;
+    }
+
+    // Requires mutex_. Advances the epoch if every thread has flushed in it and moves
+    // the decrements that are safe now to `ready`.
+    void TakeReady(std::vector<Pending>* ready) {
+        uint64_t min_epoch = MinEpoch();
+        if (min_epoch == epoch_) {
+            ++epoch_;
+        }
+        size_t kept = 0;
+        for (auto& pending : pending_) {
+            if (pending.epoch + 2 <= min_epoch) {
+                ready->push_back(pending);
+            } else {
+                pending_[kept++] = pending;
+            }
+        }
+        pending_.resize(kept);
+    }
+
+    // Flush() of a thread whose log is gone.
+    void ApplyReady() {
+        std::vector<Pending> ready;
+        {
+            std::lock_guard guard(mutex_);
+            TakeReady(&ready);
+        }
+        for (const auto& pending : ready) {
+            pending.dec(pending.object, pending.count);
+        }
+    }
+
+    template <typename T>
+    static void Inc(void* object, size_t count) {
+        static_cast<T*>(object)->IncRef(count);
+    }
+    template <typename T>
+    static void Dec(void* object, size_t count) {
+        static_cast<T*>(object)->DecRef(count);
+    }
+
+    // Set once the log of the thread is destroyed, for thread_local destructors that
+    // run later. Trivially destructible, so it outlives the log.
+    static inline thread_local bool log_gone_ = false;
+
+    ThreadLog& Local() {
+        thread_local ThreadLog log(this);
+        return log;
+    }
+
+    void Log(void* object, ptrdiff_t delta, Apply inc, Apply dec) {
+        if (log_gone_) {
+            LogEagerly(object, delta, inc, dec);
+            return;
+        }
+        ThreadLog& log = Local();
+        if (object != log.last_object) {
+            log.last_entry = &log.entries.try_emplace(object, Entry{0, inc, dec}).first->second;
+            log.last_object = object;
+        }
+        log.last_entry->delta += delta;
+        if (++log.ops >= kFlushEvery) {
+            Flush();
+        }
+    }
+
+    // Without a log: an increment is applied at once. A decrement may still race with
+    // increments in other logs, so it joins the pending ones, tagged with the current
+    // epoch, and is applied by the next flush that finds it safe.
+    void LogEagerly(void* object, ptrdiff_t delta, Apply inc, Apply dec) {
+        std::lock_guard guard(mutex_);
+        if (delta > 0) {
+            inc(object, delta);
+        } else {
+            pending_.push_back({object, static_cast<size_t>(-delta), dec, epoch_});
+        }
+    }
+
+    // Requires mutex_.
+    uint64_t MinEpoch() const {
+        uint64_t min_epoch = epoch_;
+        for (const ThreadLog* log : logs_) {
+            min_epoch = std::min(min_epoch, log->epoch);
+        }
+        return min_epoch;
+    }
+
+    mutable std::mutex mutex_;
+    uint64_t epoch_ = 0;
+    std::vector<ThreadLog*> logs_;
+    std::vector<Pending> pending_;
+};
+
+// Owning pointer with deferred reference counting (see DeferredDomain).
+// Taking a DeferredPtr from a raw pointer or an IntrusivePtr, and converting back
+// with ToIntrusive(), update the counter eagerly.
+template <typename T>
+class DeferredPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    DeferredPtr() {
+    }
+    DeferredPtr(std::nullptr_t) {
+    }
+    explicit DeferredPtr(T* ptr) : ptr_(ptr) {
+        if (ptr_) {
+            ptr_->IncRef();
+        }
+    }
+    explicit DeferredPtr(const IntrusivePtr<T>& ptr) : DeferredPtr(ptr.Get()) {
+    }
+
+    DeferredPtr(const DeferredPtr& other) : ptr_(other.ptr_) {
+        if (ptr_) {
+            DeferredDomain::Instance().LogIncrement(ptr_);
+        }
+    }
+    DeferredPtr(DeferredPtr&& other) : ptr_(std::exchange(other.ptr_, nullptr)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    DeferredPtr& operator=(const DeferredPtr& other) {
+        DeferredPtr(other).Swap(*this);
+        return *this;
+    }
+    DeferredPtr& operator=(DeferredPtr&& other) {
+        DeferredPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~DeferredPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        if (ptr_) {
+            DeferredDomain::Instance().LogDecrement(std::exchange(ptr_, nullptr));
+        }
+    }
+    void Swap(DeferredPtr& other) {
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator*() const {
+        return *ptr_;
+    }
+    T* operator->() const {
+        return ptr_;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    IntrusivePtr<T> ToIntrusive() const {
+        return ptr_ ? IntrusivePtr<T>(ptr_) : IntrusivePtr<T>();
+    }
+
+private:
+    T* ptr_ = nullptr;
+};
+
+template <typename T, typename... Args>
+DeferredPtr<T> MakeDeferred(Args&&... args) {
+    return DeferredPtr<T>(new T(std::forward<Args>(args)...));
+}
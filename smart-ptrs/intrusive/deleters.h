@@ -0,0 +1,256 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Stateful deleters for RefCounted that recycle memory instead of calling `delete`.
+// Each one comes with its allocator; `allocator.Make<T>(args...)` constructs T in
+// the allocator's memory and points the object's deleter at the allocator:
+//
+//     struct Node : SimpleRefCounted<Node, ArenaDelete> { ... };
+//     Arena arena;
+//     IntrusivePtr<Node> node = arena.Make<Node>(...);
+//
+// None of the allocators is thread-safe, and each has to outlive its objects.
+
+class Arena;
+template <typename T>
+class SlotPool;
+class FreeList;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arena: bump allocation, memory is released all at once with the arena.
+
+struct ArenaDelete {
+    ArenaDelete() {
+    }
+    explicit ArenaDelete(Arena* arena) : arena(arena) {
+    }
+
+    // Only runs the destructor.
+    template <typename T>
+    void Destroy(T* object);
+
+    Arena* arena = nullptr;
+};
+
+class Arena {
+public:
+    static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+    explicit Arena(size_t chunk_size = kDefaultChunkSize) : chunk_size_(chunk_size) {
+    }
+
+    Arena(const Arena& other) = delete;
+    Arena& operator=(const Arena& other) = delete;
+
+    ~Arena() {
+        assert(live_ == 0 && "Arena destroyed before its objects");
+    }
+
+    void* Allocate(size_t size, size_t alignment) {
+        assert(alignment <= alignof(std::max_align_t));
+        size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+        if (chunks_.empty() || offset + size > current_size_) {
+            current_size_ = std::max(chunk_size_, size + alignment);
+            chunks_.emplace_back(new std::max_align_t[(current_size_ + sizeof(std::max_align_t) - 1) /
+                                                      sizeof(std::max_align_t)]);
+            offset = 0;
+        }
+        used_ = offset + size;
+        return reinterpret_cast<char*>(chunks_.back().get()) + offset;
+    }
+
+    template <typename T, typename... Args>
+    IntrusivePtr<T> Make(Args&&... args) {
+        T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        object->GetDeleter() = ArenaDelete(this);
+        ++live_;
+        return IntrusivePtr<T>(object);
+    }
+
+    size_t LiveObjects() const {
+        return live_;
+    }
+    size_t NumChunks() const {
+        return chunks_.size();
+    }
+
+private:
+    friend struct ArenaDelete;
+
+    size_t chunk_size_;
+    size_t current_size_ = 0;
+    size_t used_ = 0;
+    size_t live_ = 0;
+    std::vector<std::unique_ptr<std::max_align_t[]>> chunks_;
+};
+
+template <typename T>
+void ArenaDelete::Destroy(T* object) {
+    object->~T();
+    --arena->live_;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SlotPool: fixed number of slots for one type, allocated once.
+
+template <typename T>
+struct PoolDelete {
+    PoolDelete() {
+    }
+    explicit PoolDelete(SlotPool<T>* pool) : pool(pool) {
+    }
+
+    // Runs the destructor and gives the slot back to the pool.
+    void Destroy(T* object);
+
+    SlotPool<T>* pool = nullptr;
+};
+
+template <typename T>
+class SlotPool {
+public:
+    explicit SlotPool(size_t capacity) : slots_(new Slot[capacity]), capacity_(capacity) {
+        free_.reserve(capacity);
+        for (size_t i = capacity; i > 0; --i) {
+            free_.push_back(&slots_[i - 1]);
+        }
+    }
+
+    SlotPool(const SlotPool& other) = delete;
+    SlotPool& operator=(const SlotPool& other) = delete;
+
+    ~SlotPool() {
+        assert(free_.size() == capacity_ && "SlotPool destroyed before its objects");
+    }
+
+    // Throws std::bad_alloc when every slot is taken.
+    template <typename... Args>
+    IntrusivePtr<T> Make(Args&&... args) {
+        if (free_.empty()) {
+            throw std::bad_alloc();
+        }
+        T* object = new (free_.back()) T(std::forward<Args>(args)...);
+        free_.pop_back();
+        object->GetDeleter() = PoolDelete<T>(this);
+        return IntrusivePtr<T>(object);
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+    size_t NumAvailable() const {
+        return free_.size();
+    }
+
+private:
+    friend struct PoolDelete<T>;
+
+    struct Slot {
+        alignas(T) char buffer[sizeof(T)];
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    std::vector<Slot*> free_;
+    size_t capacity_;
+};
+
+template <typename T>
+void PoolDelete<T>::Destroy(T* object) {
+    object->~T();
+    pool->free_.push_back(reinterpret_cast<typename SlotPool<T>::Slot*>(object));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// FreeList: blocks of one size for any types that fit, cached after release.
+
+struct FreeListDelete {
+    FreeListDelete() {
+    }
+    explicit FreeListDelete(FreeList* list) : list(list) {
+    }
+
+    // Runs the destructor and puts the block on the free list.
+    template <typename T>
+    void Destroy(T* object);
+
+    FreeList* list = nullptr;
+};
+
+class FreeList {
+public:
+    explicit FreeList(size_t block_size)
+        : block_size_(std::max(block_size, sizeof(FreeBlock))) {
+    }
+
+    FreeList(const FreeList& other) = delete;
+    FreeList& operator=(const FreeList& other) = delete;
+
+    ~FreeList() {
+        assert(live_ == 0 && "FreeList destroyed before its objects");
+        while (head_) {
+            ::operator delete(std::exchange(head_, head_->next));
+        }
+    }
+
+    void* Allocate() {
+        ++live_;
+        if (head_) {
+            --cached_;
+            return std::exchange(head_, head_->next);
+        }
+        return ::operator new(block_size_);
+    }
+    void Deallocate(void* block) {
+        --live_;
+        ++cached_;
+        head_ = new (block) FreeBlock{head_};
+    }
+
+    template <typename T, typename... Args>
+    IntrusivePtr<T> Make(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        assert(sizeof(T) <= block_size_);
+        void* block = Allocate();
+        T* object;
+        try {
+            object = new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(block);
+            throw;
+        }
+        object->GetDeleter() = FreeListDelete(this);
+        return IntrusivePtr<T>(object);
+    }
+
+    size_t BlockSize() const {
+        return block_size_;
+    }
+    size_t NumCached() const {
+        return cached_;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    size_t block_size_;
+    FreeBlock* head_ = nullptr;
+    size_t live_ = 0;
+    size_t cached_ = 0;
+};
+
+template <typename T>
+void FreeListDelete::Destroy(T* object) {
+    object->~T();
+    list->Deallocate(object);
+}
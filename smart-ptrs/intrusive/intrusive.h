@@ -1,25 +1,57 @@
 #pragma once
 
+#include <unique/compressed_pair.h>
+
 #include <cstddef>  // for std::nullptr_t
 #include <utility>  // for std::exchange / std::swap
 
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
 #include <type_traits>
 #include <iostream>
+#include <new>
+
+// The highest bit of a full-width counter marks an immortal object:
+// IncRef/DecRef only read the counter and never write it.
+inline constexpr size_t kImmortalRefCount = size_t{1} << (sizeof(size_t) * 8 - 1);
 
 class SimpleCounter {
 public:
     size_t IncRef() {
+        if (count_ & kImmortalRefCount) {
+            return count_;
+        }
         ++count_;
         return count_;
     }
     size_t DecRef() {
+        if (count_ & kImmortalRefCount) {
+            return count_;
+        }
         --count_;
         return count_;
     }
+    // IncRef() unless the counter is zero (see WeakPtr::Lock).
+    bool TryIncRef() {
+        if (count_ == 0) {
+            return false;
+        }
+        IncRef();
+        return true;
+    }
     size_t RefCount() const {
         return count_;
     }
 
+    void MakeImmortal() {
+        count_ |= kImmortalRefCount;
+    }
+    bool IsImmortal() const {
+        return count_ & kImmortalRefCount;
+    }
+
     SimpleCounter& operator=(SimpleCounter&& other) {
         return *this;
     }
@@ -28,6 +60,194 @@ private:
     size_t count_ = 0;
 };
 
+// Thread-safe counter. Copies and moves of the owning object start from zero,
+// the same way SimpleCounter ignores moves.
+class AtomicCounter {
+public:
+    AtomicCounter() = default;
+    AtomicCounter(const AtomicCounter&) {
+    }
+    AtomicCounter& operator=(const AtomicCounter&) {
+        return *this;
+    }
+
+    size_t IncRef(size_t delta = 1) {
+        if (IsImmortal()) {
+            return kImmortalRefCount;
+        }
+        return count_.fetch_add(delta, std::memory_order_relaxed) + delta;
+    }
+    size_t DecRef(size_t delta = 1) {
+        if (IsImmortal()) {
+            return kImmortalRefCount;
+        }
+        return count_.fetch_sub(delta, std::memory_order_acq_rel) - delta;
+    }
+    bool TryIncRef() {
+        size_t count = count_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+            if (count & kImmortalRefCount) {
+                return true;
+            }
+        } while (!count_.compare_exchange_weak(count, count + 1, std::memory_order_relaxed));
+        return true;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_acquire);
+    }
+
+    void MakeImmortal() {
+        count_.fetch_or(kImmortalRefCount, std::memory_order_release);
+    }
+    bool IsImmortal() const {
+        return count_.load(std::memory_order_relaxed) & kImmortalRefCount;
+    }
+
+private:
+    std::atomic<size_t> count_ = 0;
+};
+
+// Counter of selectable width (uint8_t / uint16_t / uint32_t) for small objects.
+// The maximum value is reserved for immortal objects. In sticky mode a counter that
+// reaches it saturates there: the object becomes immortal and is leaked instead of
+// being freed while still referenced. Without sticky mode overflow is a bug caught
+// by assert.
+template <typename Int, bool Sticky = false>
+class NarrowCounter {
+    static_assert(std::is_unsigned_v<Int>, "Counter type must be unsigned");
+
+public:
+    static constexpr Int kMax = std::numeric_limits<Int>::max();
+
+    NarrowCounter() = default;
+    NarrowCounter(const NarrowCounter&) {
+    }
+    NarrowCounter& operator=(const NarrowCounter&) {
+        return *this;
+    }
+
+    size_t IncRef() {
+        if (count_ == kMax) {
+            return kMax;
+        }
+        assert((Sticky || count_ + 1 != kMax) && "Reference counter overflow");
+        return ++count_;
+    }
+    size_t DecRef() {
+        if (count_ == kMax) {
+            return kMax;
+        }
+        return --count_;
+    }
+    bool TryIncRef() {
+        if (count_ == 0) {
+            return false;
+        }
+        IncRef();
+        return true;
+    }
+    size_t RefCount() const {
+        return count_;
+    }
+
+    void MakeImmortal() {
+        count_ = kMax;
+    }
+    bool IsImmortal() const {
+        return count_ == kMax;
+    }
+
+private:
+    Int count_ = 0;
+};
+
+// Thread-safe version of NarrowCounter.
+template <typename Int, bool Sticky = false>
+class AtomicNarrowCounter {
+    static_assert(std::is_unsigned_v<Int>, "Counter type must be unsigned");
+
+public:
+    static constexpr Int kMax = std::numeric_limits<Int>::max();
+
+    AtomicNarrowCounter() = default;
+    AtomicNarrowCounter(const AtomicNarrowCounter&) {
+    }
+    AtomicNarrowCounter& operator=(const AtomicNarrowCounter&) {
+        return *this;
+    }
+
+    size_t IncRef() {
+        if constexpr (Sticky) {
+            Int cur = count_.load(std::memory_order_relaxed);
+            do {
+                if (cur == kMax) {
+                    return kMax;
+                }
+            } while (!count_.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed));
+            return cur + 1;
+        } else {
+            if (IsImmortal()) {
+                return kMax;
+            }
+            Int prev = count_.fetch_add(1, std::memory_order_relaxed);
+            assert(prev + 1 != kMax && "Reference counter overflow");
+            return Int(prev + 1);
+        }
+    }
+    size_t DecRef() {
+        if constexpr (Sticky) {
+            Int cur = count_.load(std::memory_order_relaxed);
+            do {
+                if (cur == kMax) {
+                    return kMax;
+                }
+            } while (!count_.compare_exchange_weak(cur, cur - 1, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed));
+            return cur - 1;
+        } else {
+            if (IsImmortal()) {
+                return kMax;
+            }
+            return Int(count_.fetch_sub(1, std::memory_order_acq_rel) - 1);
+        }
+    }
+    bool TryIncRef() {
+        Int cur = count_.load(std::memory_order_relaxed);
+        do {
+            if (cur == 0) {
+                return false;
+            }
+            if (cur == kMax) {
+                return true;
+            }
+            assert((Sticky || cur + 1 != kMax) && "Reference counter overflow");
+        } while (!count_.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed));
+        return true;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_acquire);
+    }
+
+    void MakeImmortal() {
+        count_.store(kMax, std::memory_order_release);
+    }
+    bool IsImmortal() const {
+        return count_.load(std::memory_order_relaxed) == kMax;
+    }
+
+private:
+    std::atomic<Int> count_ = 0;
+};
+
+template <typename Int>
+using StickyCounter = NarrowCounter<Int, true>;
+
+template <typename Int>
+using AtomicStickyCounter = AtomicNarrowCounter<Int, true>;
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
@@ -35,45 +255,143 @@ struct DefaultDelete {
     }
 };
 
+// Deleter is any type with `Destroy(Derived*)`. It may carry state (a pool or an
+// arena the object came from): it is stored in the object next to the counter, and
+// an empty deleter takes no space.
 template <typename Derived, typename Counter, typename Deleter>
 class RefCounted {
 public:
     RefCounted() {
     }
+    explicit RefCounted(Deleter deleter) {
+        storage_.GetSecond() = std::move(deleter);
+    }
 
     // Increase reference counter.
     void IncRef() {
-        counter_.IncRef();
+        storage_.GetFirst().IncRef();
+    }
+
+    // Increase reference counter by `delta` at once.
+    // Requires a counter with bulk updates (e.g. AtomicCounter).
+    void IncRef(size_t delta) {
+        storage_.GetFirst().IncRef(delta);
     }
 
     // Decrease reference counter.
     // Destroy object using Deleter when the last instance dies.
     void DecRef() {
-        auto cur_state = counter_.DecRef();
+        auto cur_state = storage_.GetFirst().DecRef();
+        if (cur_state == 0) {
+            Destroy();
+        }
+    }
+
+    // Bulk version of DecRef().
+    void DecRef(size_t delta) {
+        auto cur_state = storage_.GetFirst().DecRef(delta);
         if (cur_state == 0) {
-            Deleter temp_deleter;
-            Derived* temp_ptr = static_cast<Derived*>(this);
-            temp_deleter.Destroy(temp_ptr);
+            Destroy();
         }
     }
 
     // Get current counter value (the number of strong references).
     size_t RefCount() const {
-        return counter_.RefCount();
+        return storage_.GetFirst().RefCount();
+    }
+
+    // Turn reference counting off: the object is never destroyed by DecRef
+    // and IncRef/DecRef become read-only.
+    void MakeImmortal() {
+        storage_.GetFirst().MakeImmortal();
+    }
+    bool IsImmortal() const {
+        return storage_.GetFirst().IsImmortal();
+    }
+
+    Deleter& GetDeleter() {
+        return storage_.GetSecond();
+    }
+    const Deleter& GetDeleter() const {
+        return storage_.GetSecond();
     }
 
 private:
-    Counter counter_;
+    void Destroy() {
+        // The deleter lives inside the object: take it out first.
+        Deleter temp_deleter = std::move(storage_.GetSecond());
+        Derived* temp_ptr = static_cast<Derived*>(this);
+        temp_deleter.Destroy(temp_ptr);
+    }
+
+    CompressedPair<Counter, Deleter> storage_;
+};
+
+// Same contract as RefCounted, but the counter is placed after `Payload`.
+// A narrow counter then reuses the tail padding of a non-POD payload:
+// RefCountedTail<Node, NarrowCounter<uint16_t>> for a 10-byte Node is still 12 bytes.
+template <typename Payload, typename Counter, typename Deleter = DefaultDelete>
+class RefCountedTail : public Payload {
+public:
+    using Payload::Payload;
+
+    // Increase reference counter.
+    void IncRef() {
+        storage_.GetFirst().IncRef();
+    }
+
+    // Decrease reference counter.
+    // Destroy object using Deleter when the last instance dies.
+    void DecRef() {
+        auto cur_state = storage_.GetFirst().DecRef();
+        if (cur_state == 0) {
+            Deleter temp_deleter = std::move(storage_.GetSecond());
+            temp_deleter.Destroy(this);
+        }
+    }
+
+    // Get current counter value (the number of strong references).
+    size_t RefCount() const {
+        return storage_.GetFirst().RefCount();
+    }
+
+    // Turn reference counting off: the object is never destroyed by DecRef
+    // and IncRef/DecRef become read-only.
+    void MakeImmortal() {
+        storage_.GetFirst().MakeImmortal();
+    }
+    bool IsImmortal() const {
+        return storage_.GetFirst().IsImmortal();
+    }
+
+    Deleter& GetDeleter() {
+        return storage_.GetSecond();
+    }
+    const Deleter& GetDeleter() const {
+        return storage_.GetSecond();
+    }
+
+private:
+    CompressedPair<Counter, Deleter> storage_;
 };
 
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+template <typename Derived, typename D = DefaultDelete>
+using AtomicRefCounted = RefCounted<Derived, AtomicCounter, D>;
+
+template <typename T>
+class AtomicIntrusivePtr;
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
     friend class IntrusivePtr;
 
+    template <typename Y>
+    friend class AtomicIntrusivePtr;
+
 public:
     // Constructors
     IntrusivePtr() {
@@ -188,3 +506,29 @@ IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     T* ptr = new T(args...);
     return IntrusivePtr(ptr);
 }
+
+// Storage for an immortal object, e.g. a static constant shared by many threads.
+// The object is constructed in place without allocation and is never destroyed,
+// so pointers to it stay valid even during static destruction.
+template <typename T>
+class ImmortalIntrusive {
+public:
+    template <typename... Args>
+    explicit ImmortalIntrusive(Args&&... args) {
+        T* ptr = new (&buffer_) T(std::forward<Args>(args)...);
+        ptr->MakeImmortal();
+    }
+
+    ImmortalIntrusive(const ImmortalIntrusive& other) = delete;
+    ImmortalIntrusive& operator=(const ImmortalIntrusive& other) = delete;
+
+    IntrusivePtr<T> Get() const {
+        return IntrusivePtr<T>(Object());
+    }
+    T* Object() const {
+        return std::launder(reinterpret_cast<T*>(&buffer_));
+    }
+
+private:
+    alignas(T) mutable char buffer_[sizeof(T)];
+};
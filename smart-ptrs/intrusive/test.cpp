@@ -264,7 +264,20 @@ TEST_CASE("No copies") {
 }
 
 template <typename T>
-class ObjectInPool;
+class ObjectPool;
+
+// Stateful deleter: the object goes back to the pool it came from.
+template <typename T>
+struct ReturnToPool {
+    void Destroy(T* object) {
+        pool->Release(object);
+    }
+
+    ObjectPool<T>* pool = nullptr;
+};
+
+template <typename Derived>
+using ObjectInPool = SimpleRefCounted<Derived, ReturnToPool<Derived>>;
 
 template <typename T>
 class ObjectPool {
@@ -298,7 +311,7 @@ private:
     IntrusivePtr<T> DoAllocate(Args&&... args) {
         ++allocated_;
         std::unique_ptr<T> object = std::make_unique<T>(std::forward<Args>(args)...);
-        object->SetHome(this);
+        object->GetDeleter().pool = this;
         return IntrusivePtr<T>(object.release());
     }
 
@@ -307,37 +320,6 @@ private:
     size_t allocated_ = 0;
 };
 
-template <typename Derived>
-class ObjectInPool {
-public:
-    void IncRef() {
-        count_++;
-    }
-
-    void DecRef() {
-        if (--count_ == 0) {
-            TakeMeHome();
-        }
-    }
-
-    size_t RefCount() const {
-        return count_;
-    }
-
-    void SetHome(ObjectPool<Derived>* pool) {
-        home_ = pool;
-    }
-
-private:
-    void TakeMeHome() {
-        home_->Release(static_cast<Derived*>(this));
-    }
-
-private:
-    size_t count_ = 0;
-    ObjectPool<Derived>* home_;
-};
-
 struct PoolableString : ObjectInPool<PoolableString>, std::string {
     using std::string::basic_string;
 };
@@ -0,0 +1,130 @@
+#include "atomic_intrusive.h"
+
+#include <catch.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct AtomicString : AtomicRefCounted<AtomicString>, std::string {
+    using std::string::basic_string;
+
+    ~AtomicString() {
+        ++destroyed;
+    }
+
+    static inline std::atomic<int> destroyed = 0;
+};
+
+TEST_CASE("AtomicIntrusivePtr basics") {
+    AtomicString::destroyed = 0;
+
+    SECTION("Empty") {
+        AtomicIntrusivePtr<AtomicString> slot;
+        REQUIRE(slot.IsLockFree());
+        REQUIRE(!slot.Load());
+    }
+
+    SECTION("Load keeps counts") {
+        IntrusivePtr<AtomicString> value = MakeIntrusive<AtomicString>("first");
+        {
+            AtomicIntrusivePtr<AtomicString> slot(value);
+            auto a = slot.Load();
+            auto b = slot.Load();
+            REQUIRE(*a == "first");
+            REQUIRE(a.Get() == value.Get());
+            REQUIRE(b.Get() == value.Get());
+        }
+        REQUIRE(value.UseCount() == 1);
+        value.Reset();
+        REQUIRE(AtomicString::destroyed == 1);
+    }
+
+    SECTION("Store and Exchange") {
+        AtomicIntrusivePtr<AtomicString> slot(MakeIntrusive<AtomicString>("first"));
+        auto first = slot.Load();
+        slot.Store(MakeIntrusive<AtomicString>("second"));
+        REQUIRE(first.UseCount() == 1);
+        REQUIRE(*slot.Load() == "second");
+
+        auto second = slot.Exchange(nullptr);
+        REQUIRE(*second == "second");
+        REQUIRE(second.UseCount() == 1);
+        REQUIRE(!slot.Load());
+        REQUIRE(AtomicString::destroyed == 0);
+    }
+
+    SECTION("CompareExchange") {
+        auto first = MakeIntrusive<AtomicString>("first");
+        auto second = MakeIntrusive<AtomicString>("second");
+        AtomicIntrusivePtr<AtomicString> slot(first);
+
+        IntrusivePtr<AtomicString> expected = second;
+        REQUIRE(!slot.CompareExchange(expected, MakeIntrusive<AtomicString>("third")));
+        REQUIRE(expected.Get() == first.Get());
+        REQUIRE(AtomicString::destroyed == 1);
+
+        REQUIRE(slot.CompareExchange(expected, second));
+        REQUIRE(slot.Load().Get() == second.Get());
+        expected.Reset();
+        REQUIRE(first.UseCount() == 1);
+    }
+
+    SECTION("Refill") {
+        auto value = MakeIntrusive<AtomicString>("hot");
+        AtomicIntrusivePtr<AtomicString> slot(value);
+        for (size_t i = 0; i < 3 * AtomicIntrusivePtr<AtomicString>::kBatch; ++i) {
+            slot.Load();
+        }
+        std::vector<IntrusivePtr<AtomicString>> held;
+        for (size_t i = 0; i < AtomicIntrusivePtr<AtomicString>::kBatch; ++i) {
+            held.push_back(slot.Load());
+        }
+        slot.Store(nullptr);
+        REQUIRE(value.UseCount() == held.size() + 1);
+        held.clear();
+        REQUIRE(value.UseCount() == 1);
+    }
+}
+
+TEST_CASE("AtomicIntrusivePtr concurrent") {
+    AtomicString::destroyed = 0;
+    constexpr int kReaders = 4;
+    constexpr int kWrites = 2000;
+
+    {
+        AtomicIntrusivePtr<AtomicString> slot(MakeIntrusive<AtomicString>("0"));
+        std::atomic<bool> done = false;
+        std::atomic<int> bad = 0;
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < kReaders; ++i) {
+            readers.emplace_back([&] {
+                while (!done.load()) {
+                    auto snapshot = slot.Load();
+                    if (!snapshot || snapshot->empty()) {
+                        ++bad;
+                    }
+                }
+            });
+        }
+
+        for (int i = 1; i <= kWrites; ++i) {
+            auto fresh = MakeIntrusive<AtomicString>(std::to_string(i).c_str());
+            if (i % 2 == 0) {
+                slot.Store(std::move(fresh));
+            } else {
+                auto expected = slot.Load();
+                slot.CompareExchange(expected, std::move(fresh));
+            }
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(bad == 0);
+    }
+    REQUIRE(AtomicString::destroyed == kWrites + 1);
+}
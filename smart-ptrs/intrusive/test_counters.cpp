@@ -0,0 +1,138 @@
+#include "intrusive.h"
+
+#include <catch.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename Counter>
+struct Node : RefCounted<Node<Counter>, Counter, DefaultDelete> {
+    Node(int id) : id(id) {
+    }
+
+    ~Node() {
+        ++destroyed;
+    }
+
+    int id;
+    int next = 0;
+    float weight = 0;
+
+    static inline int destroyed = 0;
+};
+
+struct PackedPayload {
+    PackedPayload(uint32_t next, uint16_t tag) : next(next), tag(tag) {
+    }
+
+    uint32_t next;
+    float weight = 0;
+    uint16_t tag;
+};
+
+TEST_CASE("Narrow counters layout") {
+    STATIC_REQUIRE(sizeof(Node<SimpleCounter>) == 24);
+    STATIC_REQUIRE(sizeof(Node<NarrowCounter<uint32_t>>) == 16);
+    STATIC_REQUIRE(sizeof(Node<AtomicNarrowCounter<uint32_t>>) == 16);
+    STATIC_REQUIRE(sizeof(Node<StickyCounter<uint8_t>>) == 16);
+
+    STATIC_REQUIRE(sizeof(PackedPayload) == 12);
+    STATIC_REQUIRE(sizeof(RefCountedTail<PackedPayload, NarrowCounter<uint16_t>>) == 12);
+    STATIC_REQUIRE(sizeof(RefCountedTail<PackedPayload, AtomicStickyCounter<uint16_t>>) == 12);
+}
+
+TEMPLATE_TEST_CASE("Narrow counters", "", NarrowCounter<uint8_t>, NarrowCounter<uint16_t>,
+                   NarrowCounter<uint32_t>, AtomicNarrowCounter<uint8_t>,
+                   AtomicNarrowCounter<uint32_t>, StickyCounter<uint8_t>,
+                   AtomicStickyCounter<uint8_t>) {
+    Node<TestType>::destroyed = 0;
+    {
+        IntrusivePtr<Node<TestType>> a = MakeIntrusive<Node<TestType>>(1);
+        std::vector<IntrusivePtr<Node<TestType>>> copies(100, a);
+        REQUIRE(a.UseCount() == 101);
+        copies.clear();
+        REQUIRE(a.UseCount() == 1);
+    }
+    REQUIRE(Node<TestType>::destroyed == 1);
+}
+
+TEMPLATE_TEST_CASE("Sticky counters saturate", "", StickyCounter<uint8_t>,
+                   AtomicStickyCounter<uint8_t>) {
+    using N = Node<TestType>;
+    N::destroyed = 0;
+
+    N* raw = new N(7);
+    {
+        std::vector<IntrusivePtr<N>> copies;
+        for (int i = 0; i < 300; ++i) {
+            copies.emplace_back(raw);
+        }
+        REQUIRE(raw->RefCount() == TestType::kMax);
+    }
+    // Immortal now: every DecRef is ignored and the object is leaked.
+    REQUIRE(raw->RefCount() == TestType::kMax);
+    REQUIRE(N::destroyed == 0);
+    IntrusivePtr<N> again(raw);
+    REQUIRE(again->id == 7);
+    REQUIRE(again.UseCount() == TestType::kMax);
+
+    again.Reset();
+    delete raw;
+}
+
+TEST_CASE("Tail counter") {
+    using Packed = RefCountedTail<PackedPayload, AtomicNarrowCounter<uint16_t>>;
+    auto a = MakeIntrusive<Packed>(5u, uint16_t{9});
+    auto b = a;
+    REQUIRE(a.UseCount() == 2);
+    REQUIRE(b->next == 5);
+    REQUIRE(b->tag == 9);
+    a.Reset();
+    REQUIRE(b.UseCount() == 1);
+}
+
+TEST_CASE("Atomic narrow counter concurrent") {
+    using N = Node<AtomicNarrowCounter<uint16_t>>;
+    auto shared = MakeIntrusive<N>(1);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([shared] {
+            for (int j = 0; j < 10000; ++j) {
+                IntrusivePtr<N> copy = shared;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(shared.UseCount() == 1);
+}
+
+struct ImmortalString : AtomicRefCounted<ImmortalString>, std::string {
+    using std::string::basic_string;
+};
+
+TEST_CASE("Immortal") {
+    static ImmortalIntrusive<ImmortalString> empty("");
+
+    IntrusivePtr<ImmortalString> a = empty.Get();
+    REQUIRE(a->IsImmortal());
+    size_t count = a.UseCount();
+    {
+        std::vector<IntrusivePtr<ImmortalString>> copies(100, a);
+        REQUIRE(a.UseCount() == count);
+    }
+    a.Reset();
+    REQUIRE(empty.Get()->empty());
+
+    Node<StickyCounter<uint16_t>> on_stack(1);
+    on_stack.MakeImmortal();
+    {
+        IntrusivePtr<Node<StickyCounter<uint16_t>>> p(&on_stack);
+        REQUIRE(p.UseCount() == StickyCounter<uint16_t>::kMax);
+    }
+    REQUIRE(on_stack.IsImmortal());
+}
@@ -0,0 +1,184 @@
+#include "deferred.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tracked : AtomicRefCounted<Tracked> {
+    static constexpr uint64_t kAlive = 0xA11CE;
+
+    Tracked() {
+        ++created;
+    }
+    ~Tracked() {
+        magic = 0;
+        ++destroyed;
+    }
+
+    uint64_t magic = kAlive;
+
+    static inline std::atomic<int> created = 0;
+    static inline std::atomic<int> destroyed = 0;
+};
+
+}  // namespace
+
+TEST_CASE("DeferredPtr coalesces updates") {
+    auto& domain = DeferredDomain::Instance();
+    Tracked::destroyed = 0;
+    {
+        auto ptr = MakeDeferred<Tracked>();
+        REQUIRE(ptr->RefCount() == 1);
+        for (int i = 0; i < 1000; ++i) {
+            DeferredPtr<Tracked> copy = ptr;
+            DeferredPtr<Tracked> other;
+            other = copy;
+        }
+        REQUIRE(ptr->RefCount() == 1);
+
+        std::vector<DeferredPtr<Tracked>> copies(10, ptr);
+        REQUIRE(ptr->RefCount() == 1);
+        domain.Flush();
+        REQUIRE(ptr->RefCount() == 11);
+        copies.clear();
+        domain.Drain();
+        REQUIRE(ptr->RefCount() == 1);
+    }
+    REQUIRE(Tracked::destroyed == 0);
+    domain.Drain();
+    REQUIRE(Tracked::destroyed == 1);
+}
+
+TEST_CASE("DeferredPtr destroys only after a flush") {
+    auto& domain = DeferredDomain::Instance();
+    Tracked::destroyed = 0;
+
+    auto ptr = MakeDeferred<Tracked>();
+    Tracked* raw = ptr.Get();
+    ptr.Reset();
+    domain.Flush();
+    // The decrement waits until later epochs are flushed.
+    REQUIRE(Tracked::destroyed == 0);
+    REQUIRE(raw->magic == Tracked::kAlive);
+    REQUIRE(domain.PendingDecrements() == 1);
+    domain.Drain();
+    REQUIRE(Tracked::destroyed == 1);
+    REQUIRE(domain.PendingDecrements() == 0);
+}
+
+TEST_CASE("DeferredPtr and IntrusivePtr") {
+    auto& domain = DeferredDomain::Instance();
+    Tracked::destroyed = 0;
+
+    auto intrusive = MakeIntrusive<Tracked>();
+    DeferredPtr<Tracked> deferred(intrusive);
+    REQUIRE(intrusive.UseCount() == 2);
+    intrusive.Reset();
+    REQUIRE(deferred->RefCount() == 1);
+
+    IntrusivePtr<Tracked> back = deferred.ToIntrusive();
+    REQUIRE(back.UseCount() == 2);
+    deferred.Reset();
+    domain.Drain();
+    REQUIRE(back.UseCount() == 1);
+    REQUIRE(Tracked::destroyed == 0);
+    back.Reset();
+    REQUIRE(Tracked::destroyed == 1);
+    REQUIRE(!DeferredPtr<Tracked>().ToIntrusive());
+}
+
+TEST_CASE("DeferredPtr flushes every kFlushEvery ops") {
+    auto& domain = DeferredDomain::Instance();
+    auto ptr = MakeDeferred<Tracked>();
+    std::vector<DeferredPtr<Tracked>> copies;
+    for (size_t i = 0; i < DeferredDomain::kFlushEvery; ++i) {
+        copies.push_back(ptr);
+    }
+    REQUIRE(ptr->RefCount() == DeferredDomain::kFlushEvery + 1);
+    copies.clear();
+    ptr.Reset();
+    domain.Drain();
+}
+
+TEST_CASE("DeferredPtr handoff between threads") {
+    constexpr int kThreads = 4;
+    constexpr int kSlots = 8;
+    constexpr int kIterations = 20000;
+
+    auto& domain = DeferredDomain::Instance();
+    Tracked::created = 0;
+    Tracked::destroyed = 0;
+
+    std::mutex mutex;
+    std::vector<DeferredPtr<Tracked>> board;
+    for (int i = 0; i < kSlots; ++i) {
+        board.push_back(MakeDeferred<Tracked>());
+    }
+    domain.Flush();
+
+    std::atomic<bool> ok = true;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<DeferredPtr<Tracked>> held;
+            for (int i = 0; i < kIterations; ++i) {
+                int slot = (i * 7 + t) % kSlots;
+                {
+                    std::lock_guard guard(mutex);
+                    held.push_back(board[slot]);
+                    if (i % 13 == 0) {
+                        board[slot] = MakeDeferred<Tracked>();
+                    }
+                }
+                if (held.size() > 16) {
+                    held.erase(held.begin(), held.begin() + 8);
+                }
+                for (const auto& ptr : held) {
+                    if (ptr->magic != Tracked::kAlive) {
+                        ok = false;
+                    }
+                }
+                if (i % 100 == 0) {
+                    DeferredDomain::Instance().Flush();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(ok);
+
+    board.clear();
+    domain.Drain();
+    REQUIRE(Tracked::created == Tracked::destroyed);
+}
+
+TEST_CASE("DeferredPtr released after the thread log is gone") {
+    struct Holder {
+        DeferredPtr<Tracked> ptr;
+    };
+    auto& domain = DeferredDomain::Instance();
+    Tracked::destroyed = 0;
+    auto shared = MakeDeferred<Tracked>();
+    std::thread thread([&] {
+        // Constructed before the thread log, so destroyed after it.
+        thread_local Holder holder;
+        holder.ptr = shared;
+    });
+    thread.join();
+    // The log applied the increment on exit; the late decrement waits for a flush.
+    REQUIRE(shared->RefCount() == 2);
+    domain.Drain();
+    REQUIRE(shared->RefCount() == 1);
+    shared.Reset();
+    domain.Drain();
+    REQUIRE(Tracked::destroyed == 1);
+}
@@ -0,0 +1,120 @@
+#include "deleters.h"
+#include "allocations_checker.h"
+
+#include <catch.hpp>
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct CountingDelete {
+    template <typename T>
+    void Destroy(T* object) {
+        ++*destroyed;
+        delete object;
+    }
+
+    int* destroyed = nullptr;
+};
+
+struct Counted : SimpleRefCounted<Counted, CountingDelete> {
+    explicit Counted(int* destroyed) : RefCounted(CountingDelete{destroyed}) {
+    }
+};
+
+struct InArena : SimpleRefCounted<InArena, ArenaDelete> {
+    explicit InArena(std::string name) : name(std::move(name)) {
+    }
+
+    std::string name;
+};
+
+struct InPool : SimpleRefCounted<InPool, PoolDelete<InPool>> {
+    explicit InPool(int value) : value(value) {
+    }
+
+    int value;
+};
+
+struct InFreeList : AtomicRefCounted<InFreeList, FreeListDelete> {
+    explicit InFreeList(int value) : value(value) {
+    }
+
+    int value;
+};
+
+}  // namespace
+
+TEST_CASE("Empty deleters take no space") {
+    struct Plain : SimpleRefCounted<Plain> {};
+    STATIC_REQUIRE(sizeof(Plain) == sizeof(size_t));
+    STATIC_REQUIRE(sizeof(InArena) == sizeof(size_t) + sizeof(ArenaDelete) + sizeof(std::string));
+}
+
+TEST_CASE("Stateful deleter") {
+    int destroyed = 0;
+    {
+        IntrusivePtr<Counted> a(new Counted(&destroyed));
+        IntrusivePtr<Counted> b = a;
+        a.Reset();
+        REQUIRE(destroyed == 0);
+    }
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("ArenaDelete") {
+    Arena arena(1024);
+    {
+        auto first = arena.Make<InArena>("first");
+        auto second = arena.Make<InArena>("second");
+        REQUIRE(first->name == "first");
+        REQUIRE(second->name == "second");
+        REQUIRE(arena.LiveObjects() == 2);
+        first.Reset();
+        REQUIRE(arena.LiveObjects() == 1);
+    }
+    REQUIRE(arena.LiveObjects() == 0);
+
+    size_t chunks = arena.NumChunks();
+    EXPECT_ZERO_ALLOCATIONS(auto node = arena.Make<InArena>(""));
+    REQUIRE(arena.NumChunks() == chunks);
+    for (int i = 0; i < 100; ++i) {
+        arena.Make<InArena>("");
+    }
+    REQUIRE(arena.NumChunks() > chunks);
+}
+
+TEST_CASE("PoolDelete") {
+    SlotPool<InPool> pool(2);
+    auto a = pool.Make(1);
+    InPool* first_slot = a.Get();
+    {
+        auto b = pool.Make(2);
+        REQUIRE(pool.NumAvailable() == 0);
+        REQUIRE_THROWS_AS(pool.Make(3), std::bad_alloc);
+    }
+    REQUIRE(pool.NumAvailable() == 1);
+    a.Reset();
+    REQUIRE(pool.NumAvailable() == 2);
+
+    EXPECT_ZERO_ALLOCATIONS(auto c = pool.Make(4); REQUIRE(c.Get() == first_slot);
+                            REQUIRE(c->value == 4));
+}
+
+TEST_CASE("FreeListDelete") {
+    FreeList list(sizeof(InFreeList));
+    InFreeList* block;
+    {
+        auto a = list.Make<InFreeList>(1);
+        block = a.Get();
+        REQUIRE(list.NumCached() == 0);
+    }
+    REQUIRE(list.NumCached() == 1);
+
+    EXPECT_ZERO_ALLOCATIONS(auto b = list.Make<InFreeList>(2); REQUIRE(b.Get() == block);
+                            REQUIRE(b->value == 2));
+    EXPECT_ONE_ALLOCATION(auto c = list.Make<InFreeList>(3); auto d = list.Make<InFreeList>(4));
+    REQUIRE(list.NumCached() == 2);
+}
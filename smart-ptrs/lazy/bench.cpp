@@ -0,0 +1,66 @@
+#include "lazy.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
+// Access cost once the object exists: LazySharedPtr against std::call_once and a
+// mutex-guarded check. Run with `test_lazy [.bench]`.
+
+namespace {
+
+constexpr int kAccesses = 1 << 26;
+
+template <typename Fn>
+double MeasureNs(Fn access) {
+    int64_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < kAccesses; ++i) {
+        sum += access();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    volatile int64_t sink = sum;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kAccesses;
+}
+
+struct OnceHolder {
+    int* Get() {
+        std::call_once(flag, [this] { value = MakeShared<int>(1); });
+        return value.Get();
+    }
+
+    std::once_flag flag;
+    SharedPtr<int> value;
+};
+
+struct LockedHolder {
+    int* Get() {
+        std::lock_guard guard(mutex);
+        if (!value) {
+            value = MakeShared<int>(1);
+        }
+        return value.Get();
+    }
+
+    std::mutex mutex;
+    SharedPtr<int> value;
+};
+
+}  // namespace
+
+TEST_CASE("LazySharedPtr access", "[.bench]") {
+    LazySharedPtr<int> lazy([] { return 1; });
+    OnceHolder once;
+    LockedHolder locked;
+
+    double lazy_ns = MeasureNs([&] { return *lazy; });
+    double once_ns = MeasureNs([&] { return *once.Get(); });
+    double locked_ns = MeasureNs([&] { return *locked.Get(); });
+
+    std::cout << "LazySharedPtr:\t" << lazy_ns << " ns/access\n"
+              << "call_once:\t" << once_ns << " ns/access\n"
+              << "mutex:\t\t" << locked_ns << " ns/access\n";
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <weak/shared.h>
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// SharedPtr to an object that is built on first access.
+//
+// The factory runs exactly once, on the first Get() / operator-> / Share(); its result
+// is constructed right in a ControlBlockMakeShared, one allocation as with MakeShared.
+// Once the object exists every access is a single acquire load of `ptr_`.
+//
+// Concurrent first accesses take no mutex: one thread claims the construction with a
+// CAS, the others wait on the state word until the object is published. If the factory
+// throws, the exception reaches the thread that ran it and the next access tries again.
+// The factory is destroyed right after a successful build.
+template <typename T, typename Factory = std::function<T()>>
+class LazySharedPtr {
+    enum State : int { kEmpty, kBuilding, kBuilt };
+
+public:
+    explicit LazySharedPtr(Factory factory) : factory_(std::move(factory)) {
+    }
+
+    LazySharedPtr(const LazySharedPtr& other) = delete;
+    LazySharedPtr& operator=(const LazySharedPtr& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        if (T* ptr = ptr_.load(std::memory_order_acquire)) {
+            return ptr;
+        }
+        return Build();
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+
+    // Owner of the object, which may outlive the LazySharedPtr.
+    SharedPtr<T> Share() const {
+        Get();
+        return value_;
+    }
+
+    bool IsBuilt() const {
+        return ptr_.load(std::memory_order_acquire) != nullptr;
+    }
+
+private:
+    T* Build() const {
+        int state = state_.load(std::memory_order_acquire);
+        while (true) {
+            if (state == kBuilt) {
+                return ptr_.load(std::memory_order_acquire);
+            }
+            if (state == kBuilding) {
+                state_.wait(kBuilding, std::memory_order_acquire);
+                state = state_.load(std::memory_order_acquire);
+                continue;
+            }
+            if (state_.compare_exchange_weak(state, kBuilding, std::memory_order_acquire)) {
+                break;
+            }
+        }
+
+        T* ptr = nullptr;
+        try {
+            auto block = new ControlBlockMakeShared<T>(ptr, core::FromFactory(), *factory_);
+            value_ = SharedPtr<T>(block, ptr, true);
+        } catch (...) {
+            state_.store(kEmpty, std::memory_order_release);
+            state_.notify_all();
+            throw;
+        }
+        factory_.reset();
+        ptr_.store(ptr, std::memory_order_release);
+        state_.store(kBuilt, std::memory_order_release);
+        state_.notify_all();
+        return ptr;
+    }
+
+    mutable std::atomic<T*> ptr_ = nullptr;
+    mutable std::atomic<int> state_ = kEmpty;
+    mutable SharedPtr<T> value_;
+    mutable std::optional<Factory> factory_;
+};
+
+// Usage: `auto index = MakeLazyShared<Index>([] { return Index(LoadFile("index.bin")); });`
+template <typename T, typename Factory>
+LazySharedPtr<T, std::decay_t<Factory>> MakeLazyShared(Factory&& factory) {
+    return LazySharedPtr<T, std::decay_t<Factory>>(std::forward<Factory>(factory));
+}
@@ -0,0 +1,112 @@
+#include "lazy.h"
+#include "allocations_checker.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Index {
+    explicit Index(std::string name) : name(std::move(name)) {
+        ++built;
+    }
+    Index(const Index& other) = delete;
+    Index(Index&& other) = delete;
+
+    std::string name;
+
+    static inline std::atomic<int> built = 0;
+};
+
+}  // namespace
+
+TEST_CASE("LazySharedPtr builds on first access") {
+    Index::built = 0;
+    int calls = 0;
+    auto index = MakeLazyShared<Index>([&calls] {
+        ++calls;
+        return Index("index");
+    });
+    REQUIRE(!index.IsBuilt());
+    REQUIRE(Index::built == 0);
+
+    REQUIRE(index->name == "index");
+    REQUIRE(index.IsBuilt());
+    REQUIRE((*index).name == "index");
+    REQUIRE(index.Get() == index.Get());
+    REQUIRE(calls == 1);
+    REQUIRE(Index::built == 1);
+}
+
+TEST_CASE("LazySharedPtr single allocation") {
+    LazySharedPtr<std::string> lazy([] { return std::string("short"); });
+    EXPECT_ONE_ALLOCATION(REQUIRE(*lazy == "short"));
+    EXPECT_ZERO_ALLOCATIONS(REQUIRE(lazy->size() == 5));
+}
+
+TEST_CASE("LazySharedPtr Share") {
+    SharedPtr<Index> shared;
+    {
+        auto lazy = MakeLazyShared<Index>([] { return Index("shared"); });
+        shared = lazy.Share();
+        REQUIRE(lazy.Get() == shared.Get());
+        REQUIRE(shared.UseCount() == 2);
+    }
+    REQUIRE(shared.UseCount() == 1);
+    REQUIRE(shared->name == "shared");
+}
+
+TEST_CASE("LazySharedPtr factory throws") {
+    int calls = 0;
+    auto lazy = MakeLazyShared<int>([&calls] {
+        if (++calls == 1) {
+            throw std::runtime_error("not yet");
+        }
+        return 42;
+    });
+    REQUIRE_THROWS_AS(lazy.Get(), std::runtime_error);
+    REQUIRE(!lazy.IsBuilt());
+    REQUIRE(*lazy == 42);
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("LazySharedPtr concurrent first access") {
+    constexpr int kThreads = 8;
+    for (int round = 0; round < 100; ++round) {
+        Index::built = 0;
+        auto lazy = MakeLazyShared<Index>([] {
+            std::this_thread::yield();
+            return Index("concurrent");
+        });
+        std::atomic<bool> start = false;
+        std::atomic<bool> ok = true;
+        std::vector<std::thread> threads;
+        std::vector<Index*> seen(kThreads);
+        for (int i = 0; i < kThreads; ++i) {
+            threads.emplace_back([&, i] {
+                while (!start.load()) {
+                }
+                seen[i] = lazy.Get();
+                if (seen[i]->name != "concurrent") {
+                    ok = false;
+                }
+            });
+        }
+        start = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(ok);
+        REQUIRE(Index::built == 1);
+        for (Index* index : seen) {
+            REQUIRE(index == lazy.Get());
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include "hash_map.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+// Versioned lookup table: every update publishes a new version that readers may
+// still hold. PersistentHashMap shares structure between versions, the baseline
+// copies the whole std::unordered_map and swaps it in. Run with `test_persistent [bench]`.
+
+namespace {
+
+constexpr int kEntries = 100'000;
+constexpr int kLookups = 1 << 21;
+constexpr int kUpdates = 200;
+
+template <typename F>
+double MeasureNs(int iterations, F&& run) {
+    auto begin = std::chrono::steady_clock::now();
+    run();
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+}  // namespace
+
+TEST_CASE("PersistentHashMap vs unordered_map copy-and-swap", "[.bench]") {
+    PersistentHashMap<int, int> hamt;
+    auto table = std::make_shared<std::unordered_map<int, int>>();
+    for (int i = 0; i < kEntries; ++i) {
+        hamt = std::move(hamt).Set(i, i);
+        (*table)[i] = i;
+    }
+
+    std::mt19937 gen(7);
+    int64_t sum = 0;
+
+    double hamt_lookup = MeasureNs(kLookups, [&] {
+        for (int i = 0; i < kLookups; ++i) {
+            sum += *hamt.Find(gen() % kEntries);
+        }
+    });
+    double table_lookup = MeasureNs(kLookups, [&] {
+        for (int i = 0; i < kLookups; ++i) {
+            sum += table->find(gen() % kEntries)->second;
+        }
+    });
+
+    double hamt_update = MeasureNs(kUpdates, [&] {
+        for (int i = 0; i < kUpdates; ++i) {
+            PersistentHashMap<int, int> old_version = hamt;
+            hamt = hamt.Set(gen() % kEntries, i);
+        }
+    });
+    double table_update = MeasureNs(kUpdates, [&] {
+        for (int i = 0; i < kUpdates; ++i) {
+            std::shared_ptr<std::unordered_map<int, int>> old_version = table;
+            auto fresh = std::make_shared<std::unordered_map<int, int>>(*table);
+            (*fresh)[gen() % kEntries] = i;
+            table.swap(fresh);
+        }
+    });
+
+    std::cout << "entries: " << kEntries << "\t(" << sum << ")\n"
+              << "lookup\tPersistentHashMap: " << hamt_lookup
+              << " ns\tunordered_map: " << table_lookup << " ns\n"
+              << "update\tPersistentHashMap: " << hamt_update
+              << " ns\tunordered_map copy-and-swap: " << table_update << " ns\n";
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <intrusive/intrusive.h>
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Persistent hash map: a hash array mapped trie (CHAMP layout) of IntrusivePtr nodes.
+// Every node consumes 5 bits of the hash and keeps two 32-bit bitmaps: one for
+// entries stored inline and one for child nodes; the position inside the packed
+// arrays is the popcount of the lower bits. Keys whose whole hash collides end up
+// in a collision node.
+//
+// As with PersistentVector, `m.Set(k, v)` and `m.Erase(k)` return a new version and
+// copy only the nodes on the path, while `std::move(m).Set(k, v)` updates nodes
+// with RefCount() == 1 in place. Old versions stay valid and can be read from other
+// threads without locks.
+template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+class PersistentHashMap {
+    static constexpr size_t kBits = 5;
+    static constexpr size_t kMask = (size_t{1} << kBits) - 1;
+    static constexpr size_t kHashBits = sizeof(size_t) * 8;
+
+    using Entry = std::pair<K, V>;
+
+    struct Node;
+
+    struct NodeDelete {
+        static void Destroy(Node* node);
+    };
+
+    struct Node : RefCounted<Node, AtomicCounter, NodeDelete> {
+        explicit Node(bool is_collision) : is_collision(is_collision) {
+        }
+
+        bool is_collision;
+    };
+
+    struct BitmapNode : Node {
+        BitmapNode() : Node(false) {
+        }
+
+        size_t EntryIndex(uint32_t bit) const {
+            return std::popcount(datamap & (bit - 1));
+        }
+        size_t ChildIndex(uint32_t bit) const {
+            return std::popcount(nodemap & (bit - 1));
+        }
+
+        uint32_t datamap = 0;
+        uint32_t nodemap = 0;
+        std::vector<Entry> entries;
+        std::vector<IntrusivePtr<Node>> children;
+    };
+
+    struct CollisionNode : Node {
+        CollisionNode() : Node(true) {
+        }
+
+        std::vector<Entry> entries;
+    };
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    PersistentHashMap() {
+    }
+
+    PersistentHashMap(const PersistentHashMap& other) = default;
+    PersistentHashMap(PersistentHashMap&& other)
+        : root_(std::move(other.root_)), size_(std::exchange(other.size_, 0)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    PersistentHashMap& operator=(const PersistentHashMap& other) = default;
+    PersistentHashMap& operator=(PersistentHashMap&& other) {
+        if (this != &other) {
+            root_ = std::move(other.root_);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Updates
+
+    PersistentHashMap Set(K key, V value) const& {
+        PersistentHashMap result = *this;
+        result.DoSet(std::move(key), std::move(value));
+        return result;
+    }
+    PersistentHashMap Set(K key, V value) && {
+        DoSet(std::move(key), std::move(value));
+        return std::move(*this);
+    }
+
+    PersistentHashMap Erase(const K& key) const& {
+        if (!Find(key)) {
+            return *this;
+        }
+        PersistentHashMap result = *this;
+        result.DoErase(key);
+        return result;
+    }
+    PersistentHashMap Erase(const K& key) && {
+        if (Find(key)) {
+            DoErase(key);
+        }
+        return std::move(*this);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Returns nullptr if there is no such key.
+    const V* Find(const K& key) const {
+        size_t hash = Hash{}(key);
+        const Node* node = root_.Get();
+        for (size_t shift = 0; node; shift += kBits) {
+            if (node->is_collision) {
+                for (const auto& entry : static_cast<const CollisionNode*>(node)->entries) {
+                    if (Equal{}(entry.first, key)) {
+                        return &entry.second;
+                    }
+                }
+                return nullptr;
+            }
+            auto bitmap = static_cast<const BitmapNode*>(node);
+            uint32_t bit = Bit(hash, shift);
+            if (bitmap->datamap & bit) {
+                const Entry& entry = bitmap->entries[bitmap->EntryIndex(bit)];
+                return Equal{}(entry.first, key) ? &entry.second : nullptr;
+            }
+            if (!(bitmap->nodemap & bit)) {
+                return nullptr;
+            }
+            node = bitmap->children[bitmap->ChildIndex(bit)].Get();
+        }
+        return nullptr;
+    }
+    bool Contains(const K& key) const {
+        return Find(key) != nullptr;
+    }
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    // Calls `f(key, value)` for every entry, in hash order.
+    template <typename F>
+    void ForEach(F&& f) const {
+        if (root_) {
+            ForEach(root_.Get(), f);
+        }
+    }
+
+private:
+    static uint32_t Bit(size_t hash, size_t shift) {
+        return uint32_t{1} << ((hash >> shift) & kMask);
+    }
+
+    // Copy-on-write: copies the node unless this path is its only owner.
+    template <typename X>
+    static X* Unique(IntrusivePtr<Node>& slot) {
+        if (slot->RefCount() != 1) {
+            slot = IntrusivePtr<Node>(new X(*static_cast<X*>(slot.Get())));
+        }
+        return static_cast<X*>(slot.Get());
+    }
+
+    // Node holding two entries whose hashes agree below `shift`.
+    static IntrusivePtr<Node> MergeTwo(Entry first, size_t first_hash, Entry second,
+                                       size_t second_hash, size_t shift) {
+        if (shift >= kHashBits) {
+            auto node = new CollisionNode;
+            node->entries.push_back(std::move(first));
+            node->entries.push_back(std::move(second));
+            return IntrusivePtr<Node>(node);
+        }
+        auto node = new BitmapNode;
+        uint32_t first_bit = Bit(first_hash, shift);
+        uint32_t second_bit = Bit(second_hash, shift);
+        if (first_bit == second_bit) {
+            node->nodemap = first_bit;
+            node->children.push_back(MergeTwo(std::move(first), first_hash, std::move(second),
+                                              second_hash, shift + kBits));
+        } else {
+            node->datamap = first_bit | second_bit;
+            if (first_bit > second_bit) {
+                std::swap(first, second);
+            }
+            node->entries.push_back(std::move(first));
+            node->entries.push_back(std::move(second));
+        }
+        return IntrusivePtr<Node>(node);
+    }
+
+    void DoSet(K key, V value) {
+        if (!root_) {
+            root_ = IntrusivePtr<Node>(new BitmapNode);
+        }
+        size_t hash = Hash{}(key);
+        if (Insert(root_, 0, hash, key, value)) {
+            ++size_;
+        }
+    }
+
+    // Returns true if a new key was added.
+    static bool Insert(IntrusivePtr<Node>& slot, size_t shift, size_t hash, K& key, V& value) {
+        if (slot->is_collision) {
+            CollisionNode* node = Unique<CollisionNode>(slot);
+            for (auto& entry : node->entries) {
+                if (Equal{}(entry.first, key)) {
+                    entry.second = std::move(value);
+                    return false;
+                }
+            }
+            node->entries.emplace_back(std::move(key), std::move(value));
+            return true;
+        }
+
+        BitmapNode* node = Unique<BitmapNode>(slot);
+        uint32_t bit = Bit(hash, shift);
+        if (node->datamap & bit) {
+            size_t index = node->EntryIndex(bit);
+            Entry& entry = node->entries[index];
+            if (Equal{}(entry.first, key)) {
+                entry.second = std::move(value);
+                return false;
+            }
+            size_t entry_hash = Hash{}(entry.first);
+            IntrusivePtr<Node> child = MergeTwo(std::move(entry), entry_hash,
+                                                Entry(std::move(key), std::move(value)), hash,
+                                                shift + kBits);
+            node->entries.erase(node->entries.begin() + index);
+            node->datamap ^= bit;
+            node->nodemap |= bit;
+            node->children.insert(node->children.begin() + node->ChildIndex(bit),
+                                  std::move(child));
+            return true;
+        }
+        if (node->nodemap & bit) {
+            return Insert(node->children[node->ChildIndex(bit)], shift + kBits, hash, key, value);
+        }
+        node->datamap |= bit;
+        node->entries.emplace(node->entries.begin() + node->EntryIndex(bit), std::move(key),
+                              std::move(value));
+        return true;
+    }
+
+    // The key is known to be present.
+    void DoErase(const K& key) {
+        Remove(root_, 0, Hash{}(key), key);
+        if (--size_ == 0) {
+            root_.Reset();
+        }
+    }
+
+    static size_t NumEntries(const Node* node) {
+        if (node->is_collision) {
+            return static_cast<const CollisionNode*>(node)->entries.size();
+        }
+        auto bitmap = static_cast<const BitmapNode*>(node);
+        return bitmap->nodemap ? 2 : bitmap->entries.size();
+    }
+
+    static Entry& SingleEntry(Node* node) {
+        if (node->is_collision) {
+            return static_cast<CollisionNode*>(node)->entries.front();
+        }
+        return static_cast<BitmapNode*>(node)->entries.front();
+    }
+
+    static void Remove(IntrusivePtr<Node>& slot, size_t shift, size_t hash, const K& key) {
+        if (slot->is_collision) {
+            CollisionNode* node = Unique<CollisionNode>(slot);
+            for (size_t i = 0; i < node->entries.size(); ++i) {
+                if (Equal{}(node->entries[i].first, key)) {
+                    node->entries.erase(node->entries.begin() + i);
+                    return;
+                }
+            }
+            return;
+        }
+
+        BitmapNode* node = Unique<BitmapNode>(slot);
+        uint32_t bit = Bit(hash, shift);
+        if (node->datamap & bit) {
+            node->entries.erase(node->entries.begin() + node->EntryIndex(bit));
+            node->datamap ^= bit;
+            return;
+        }
+        size_t child_index = node->ChildIndex(bit);
+        IntrusivePtr<Node>& child = node->children[child_index];
+        Remove(child, shift + kBits, hash, key);
+        // Keep the trie canonical: a child left with one entry moves up into this node.
+        if (NumEntries(child.Get()) == 1) {
+            Entry entry = std::move(SingleEntry(child.Get()));
+            node->children.erase(node->children.begin() + child_index);
+            node->nodemap ^= bit;
+            node->datamap |= bit;
+            node->entries.insert(node->entries.begin() + node->EntryIndex(bit), std::move(entry));
+        }
+    }
+
+    template <typename F>
+    static void ForEach(const Node* node, F& f) {
+        if (node->is_collision) {
+            for (const auto& entry : static_cast<const CollisionNode*>(node)->entries) {
+                f(entry.first, entry.second);
+            }
+            return;
+        }
+        auto bitmap = static_cast<const BitmapNode*>(node);
+        for (const auto& entry : bitmap->entries) {
+            f(entry.first, entry.second);
+        }
+        for (const auto& child : bitmap->children) {
+            ForEach(child.Get(), f);
+        }
+    }
+
+    IntrusivePtr<Node> root_;
+    size_t size_ = 0;
+};
+
+template <typename K, typename V, typename Hash, typename Equal>
+void PersistentHashMap<K, V, Hash, Equal>::NodeDelete::Destroy(Node* node) {
+    if (node->is_collision) {
+        delete static_cast<CollisionNode*>(node);
+    } else {
+        delete static_cast<BitmapNode*>(node);
+    }
+}
@@ -0,0 +1,119 @@
+#include "vector.h"
+
+#include <catch.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+template <typename T>
+std::vector<T> ToStd(const PersistentVector<T>& vector) {
+    std::vector<T> result;
+    vector.ForEach([&](const T& value) { result.push_back(value); });
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE("PersistentVector basics") {
+    PersistentVector<int> empty;
+    REQUIRE(empty.Empty());
+
+    auto one = empty.PushBack(1);
+    REQUIRE(empty.Size() == 0);
+    REQUIRE(one.Size() == 1);
+    REQUIRE(one[0] == 1);
+    REQUIRE(one.PopBack().Empty());
+
+    auto changed = one.Set(0, 5);
+    REQUIRE(one[0] == 1);
+    REQUIRE(changed[0] == 5);
+}
+
+TEST_CASE("PersistentVector matches std::vector") {
+    // Crosses the tail, one-level and two-level trie boundaries.
+    constexpr int kSize = 32 * 32 * 32 + 100;
+
+    std::vector<int> expected;
+    PersistentVector<int> vector;
+    for (int i = 0; i < kSize; ++i) {
+        vector = vector.PushBack(i);
+        expected.push_back(i);
+        REQUIRE(vector.Back() == i);
+    }
+    REQUIRE(ToStd(vector) == expected);
+
+    for (int i = 0; i < kSize; i += 37) {
+        vector = vector.Set(i, -i);
+        expected[i] = -i;
+    }
+    REQUIRE(ToStd(vector) == expected);
+
+    while (!vector.Empty()) {
+        REQUIRE(vector.Back() == expected.back());
+        vector = vector.PopBack();
+        expected.pop_back();
+        REQUIRE(vector.Size() == expected.size());
+    }
+}
+
+TEST_CASE("PersistentVector versions are independent") {
+    PersistentVector<std::string> base;
+    for (int i = 0; i < 2000; ++i) {
+        base = std::move(base).PushBack(std::to_string(i));
+    }
+
+    std::vector<PersistentVector<std::string>> versions;
+    versions.push_back(base);
+    for (int i = 0; i < 50; ++i) {
+        versions.push_back(versions.back().Set(i * 40, "v" + std::to_string(i)));
+    }
+    versions.push_back(base.PopBack().PopBack());
+    versions.push_back(base.PushBack("new"));
+
+    REQUIRE(base[0] == "0");
+    REQUIRE(base.Size() == 2000);
+    for (int i = 1; i <= 50; ++i) {
+        const auto& version = versions[i];
+        REQUIRE(version[(i - 1) * 40] == "v" + std::to_string(i - 1));
+        REQUIRE(version[(i - 1) * 40 + 1] == std::to_string((i - 1) * 40 + 1));
+    }
+    REQUIRE(versions[51].Size() == 1998);
+    REQUIRE(versions[52].Back() == "new");
+    REQUIRE(base.Back() == "1999");
+}
+
+TEST_CASE("PersistentVector transient updates") {
+    auto counter = std::make_shared<int>(0);
+    PersistentVector<std::shared_ptr<int>> vector;
+    for (int i = 0; i < 1000; ++i) {
+        vector = std::move(vector).PushBack(counter);
+    }
+    REQUIRE(counter.use_count() == 1001);
+
+    // In place: the only version owns every node, nothing is copied.
+    const std::shared_ptr<int>* first = &vector[0];
+    vector = std::move(vector).Set(0, nullptr);
+    REQUIRE(&vector[0] == first);
+    REQUIRE(counter.use_count() == 1000);
+
+    // A snapshot pins the nodes, so the next update copies the path instead.
+    auto snapshot = vector;
+    vector = std::move(vector).Set(1, nullptr);
+    REQUIRE(&vector[0] != first);
+    REQUIRE(&snapshot[0] == first);
+    REQUIRE(snapshot[1] == counter);
+    // Only the first leaf was copied: 30 extra references.
+    REQUIRE(counter.use_count() == 1030);
+
+    snapshot = PersistentVector<std::shared_ptr<int>>();
+    REQUIRE(counter.use_count() == 999);
+    while (!vector.Empty()) {
+        vector = std::move(vector).PopBack();
+    }
+    REQUIRE(counter.use_count() == 1);
+}
@@ -0,0 +1,117 @@
+#include "hash_map.h"
+
+#include <catch.hpp>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Only 4 distinct hashes: forces collision nodes at the bottom of the trie.
+struct BadHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key % 4) * 0x9E3779B97F4A7C15ULL;
+    }
+};
+
+template <typename Map>
+std::map<int, int> ToStd(const Map& map) {
+    std::map<int, int> result;
+    map.ForEach([&](int key, int value) { result.emplace(key, value); });
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE("PersistentHashMap basics") {
+    PersistentHashMap<std::string, int> empty;
+    REQUIRE(empty.Empty());
+    REQUIRE(!empty.Find("a"));
+
+    auto one = empty.Set("a", 1);
+    auto two = one.Set("b", 2);
+    auto changed = two.Set("a", 10);
+    REQUIRE(one.Size() == 1);
+    REQUIRE(two.Size() == 2);
+    REQUIRE(changed.Size() == 2);
+    REQUIRE(*one.Find("a") == 1);
+    REQUIRE(!one.Contains("b"));
+    REQUIRE(*two.Find("a") == 1);
+    REQUIRE(*changed.Find("a") == 10);
+
+    auto erased = changed.Erase("a");
+    REQUIRE(erased.Size() == 1);
+    REQUIRE(!erased.Contains("a"));
+    REQUIRE(changed.Contains("a"));
+    REQUIRE(erased.Erase("missing").Size() == 1);
+    REQUIRE(erased.Erase("b").Empty());
+}
+
+TEMPLATE_TEST_CASE("PersistentHashMap matches std::map", "", std::hash<int>, BadHash) {
+    PersistentHashMap<int, int, TestType> map;
+    std::map<int, int> expected;
+    std::mt19937 gen(42);
+
+    constexpr int kOps = 20000;
+    int key_range = std::is_same_v<TestType, BadHash> ? 64 : 5000;
+    for (int i = 0; i < kOps; ++i) {
+        int key = gen() % key_range;
+        if (gen() % 3 == 0) {
+            map = map.Erase(key);
+            expected.erase(key);
+        } else {
+            map = std::move(map).Set(key, i);
+            expected[key] = i;
+        }
+        REQUIRE(map.Size() == expected.size());
+    }
+    REQUIRE(ToStd(map) == expected);
+    for (int key = 0; key < key_range; ++key) {
+        const int* value = map.Find(key);
+        REQUIRE((value != nullptr) == expected.contains(key));
+        if (value) {
+            REQUIRE(*value == expected[key]);
+        }
+    }
+}
+
+TEST_CASE("PersistentHashMap versions are independent") {
+    PersistentHashMap<int, int> base;
+    for (int i = 0; i < 1000; ++i) {
+        base = std::move(base).Set(i, i);
+    }
+
+    std::vector<PersistentHashMap<int, int>> versions{base};
+    for (int i = 0; i < 100; ++i) {
+        versions.push_back(versions.back().Set(i, -i).Erase(500 + i));
+    }
+    for (int i = 0; i <= 100; ++i) {
+        const auto& version = versions[i];
+        REQUIRE(version.Size() == static_cast<size_t>(1000 - i));
+        for (int key = 0; key < 100; ++key) {
+            REQUIRE(*version.Find(key) == (key < i ? -key : key));
+            REQUIRE(version.Contains(500 + key) == (key >= i));
+        }
+    }
+}
+
+TEST_CASE("PersistentHashMap in-place updates") {
+    PersistentHashMap<int, std::string> map;
+    for (int i = 0; i < 100; ++i) {
+        map = std::move(map).Set(i, "x");
+    }
+    const std::string* value = map.Find(7);
+    map = std::move(map).Set(7, "y");
+    REQUIRE(map.Find(7) == value);
+    REQUIRE(*value == "y");
+
+    auto snapshot = map;
+    map = std::move(map).Set(7, "z");
+    REQUIRE(map.Find(7) != value);
+    REQUIRE(*snapshot.Find(7) == "y");
+    REQUIRE(*map.Find(7) == "z");
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <intrusive/intrusive.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+// Persistent (immutable) vector: a 32-way radix trie of IntrusivePtr nodes plus a
+// tail leaf, as in Clojure. Copying a vector is O(1) and shares all nodes.
+//
+// `v.Set(i, x)`, `v.PushBack(x)` and `v.PopBack()` leave `v` untouched and return a
+// new version that copies only the O(log32 n) nodes on the path. Called on an rvalue
+// (`std::move(v).PushBack(x)`) they work as a transient: nodes that no other version
+// refers to (RefCount() == 1) are updated in place.
+//
+// T must be default constructible.
+template <typename T>
+class PersistentVector {
+    static constexpr size_t kBits = 5;
+    static constexpr size_t kWidth = size_t{1} << kBits;
+    static constexpr size_t kMask = kWidth - 1;
+
+    struct Node;
+
+    struct NodeDelete {
+        static void Destroy(Node* node);
+    };
+
+    struct Node : RefCounted<Node, AtomicCounter, NodeDelete> {
+        explicit Node(bool is_leaf) : is_leaf(is_leaf) {
+        }
+
+        bool is_leaf;
+    };
+
+    struct Branch : Node {
+        Branch() : Node(false) {
+        }
+
+        std::array<IntrusivePtr<Node>, kWidth> children;
+    };
+
+    struct Leaf : Node {
+        Leaf() : Node(true) {
+        }
+
+        std::array<T, kWidth> values;
+    };
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    PersistentVector() {
+    }
+
+    PersistentVector(const PersistentVector& other) = default;
+    PersistentVector(PersistentVector&& other)
+        : size_(std::exchange(other.size_, 0)),
+          shift_(std::exchange(other.shift_, kBits)),
+          root_(std::move(other.root_)),
+          tail_(std::move(other.tail_)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    PersistentVector& operator=(const PersistentVector& other) = default;
+    PersistentVector& operator=(PersistentVector&& other) {
+        if (this != &other) {
+            size_ = std::exchange(other.size_, 0);
+            shift_ = std::exchange(other.shift_, kBits);
+            root_ = std::move(other.root_);
+            tail_ = std::move(other.tail_);
+        }
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Updates
+
+    PersistentVector Set(size_t i, T value) const& {
+        PersistentVector result = *this;
+        result.DoSet(i, std::move(value));
+        return result;
+    }
+    PersistentVector Set(size_t i, T value) && {
+        DoSet(i, std::move(value));
+        return std::move(*this);
+    }
+
+    PersistentVector PushBack(T value) const& {
+        PersistentVector result = *this;
+        result.DoPushBack(std::move(value));
+        return result;
+    }
+    PersistentVector PushBack(T value) && {
+        DoPushBack(std::move(value));
+        return std::move(*this);
+    }
+
+    PersistentVector PopBack() const& {
+        PersistentVector result = *this;
+        result.DoPopBack();
+        return result;
+    }
+    PersistentVector PopBack() && {
+        DoPopBack();
+        return std::move(*this);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    const T& operator[](size_t i) const {
+        assert(i < size_);
+        return LeafFor(i)->values[i & kMask];
+    }
+    const T& Back() const {
+        return (*this)[size_ - 1];
+    }
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    // Calls `f` for every element in order, one leaf at a time.
+    template <typename F>
+    void ForEach(F&& f) const {
+        for (size_t start = 0; start < size_; start += kWidth) {
+            const Leaf* leaf = LeafFor(start);
+            size_t count = std::min(kWidth, size_ - start);
+            for (size_t j = 0; j < count; ++j) {
+                f(leaf->values[j]);
+            }
+        }
+    }
+
+private:
+    size_t TailOffset() const {
+        return size_ < kWidth ? 0 : ((size_ - 1) >> kBits) << kBits;
+    }
+
+    static Branch* AsBranch(Node* node) {
+        return static_cast<Branch*>(node);
+    }
+
+    Leaf* LeafFor(size_t i) const {
+        if (i >= TailOffset()) {
+            return static_cast<Leaf*>(tail_.Get());
+        }
+        Node* node = root_.Get();
+        for (size_t level = shift_; level > 0; level -= kBits) {
+            node = AsBranch(node)->children[(i >> level) & kMask].Get();
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    // Copy-on-write: copies the node unless this path is its only owner.
+    template <typename X>
+    static X* Unique(IntrusivePtr<Node>& slot) {
+        if (slot->RefCount() != 1) {
+            slot = IntrusivePtr<Node>(new X(*static_cast<X*>(slot.Get())));
+        }
+        return static_cast<X*>(slot.Get());
+    }
+
+    static IntrusivePtr<Node> NewPath(size_t level, IntrusivePtr<Node> node) {
+        while (level != 0) {
+            IntrusivePtr<Node> parent(new Branch);
+            AsBranch(parent.Get())->children[0] = std::move(node);
+            node = std::move(parent);
+            level -= kBits;
+        }
+        return node;
+    }
+
+    void DoSet(size_t i, T value) {
+        assert(i < size_);
+        if (i >= TailOffset()) {
+            Unique<Leaf>(tail_)->values[i & kMask] = std::move(value);
+            return;
+        }
+        Branch* node = Unique<Branch>(root_);
+        for (size_t level = shift_; level > kBits; level -= kBits) {
+            node = Unique<Branch>(node->children[(i >> level) & kMask]);
+        }
+        Unique<Leaf>(node->children[(i >> kBits) & kMask])->values[i & kMask] = std::move(value);
+    }
+
+    void DoPushBack(T value) {
+        size_t tail_size = size_ - TailOffset();
+        if (tail_size < kWidth) {
+            if (!tail_) {
+                tail_ = IntrusivePtr<Node>(new Leaf);
+            }
+            Unique<Leaf>(tail_)->values[tail_size] = std::move(value);
+            ++size_;
+            return;
+        }
+
+        IntrusivePtr<Node> full_tail = std::move(tail_);
+        if (!root_) {
+            root_ = IntrusivePtr<Node>(new Branch);
+        }
+        if ((size_ >> kBits) > (size_t{1} << shift_)) {
+            IntrusivePtr<Node> new_root(new Branch);
+            AsBranch(new_root.Get())->children[0] = std::move(root_);
+            AsBranch(new_root.Get())->children[1] = NewPath(shift_, std::move(full_tail));
+            root_ = std::move(new_root);
+            shift_ += kBits;
+        } else {
+            Branch* node = Unique<Branch>(root_);
+            for (size_t level = shift_;; level -= kBits) {
+                IntrusivePtr<Node>& child = node->children[((size_ - 1) >> level) & kMask];
+                if (level == kBits) {
+                    child = std::move(full_tail);
+                    break;
+                }
+                if (!child) {
+                    child = NewPath(level - kBits, std::move(full_tail));
+                    break;
+                }
+                node = Unique<Branch>(child);
+            }
+        }
+
+        tail_ = IntrusivePtr<Node>(new Leaf);
+        static_cast<Leaf*>(tail_.Get())->values[0] = std::move(value);
+        ++size_;
+    }
+
+    void DoPopBack() {
+        assert(size_ != 0);
+        size_t tail_size = size_ - TailOffset();
+        if (tail_size > 1 || size_ == 1) {
+            Unique<Leaf>(tail_)->values[tail_size - 1] = T();
+            if (--size_ == 0) {
+                tail_.Reset();
+            }
+            return;
+        }
+
+        // The tail becomes empty: the last leaf of the trie takes its place.
+        IntrusivePtr<Node> new_tail(LeafFor(size_ - 2));
+        if (PopTail(root_, shift_)) {
+            root_.Reset();
+            shift_ = kBits;
+        }
+        if (shift_ > kBits && !AsBranch(root_.Get())->children[1]) {
+            IntrusivePtr<Node> child = AsBranch(root_.Get())->children[0];
+            root_ = std::move(child);
+            shift_ -= kBits;
+        }
+        tail_ = std::move(new_tail);
+        --size_;
+    }
+
+    // Removes the last leaf under `slot`. Returns true if the node became empty.
+    bool PopTail(IntrusivePtr<Node>& slot, size_t level) {
+        size_t index = ((size_ - 2) >> level) & kMask;
+        if (level > kBits) {
+            Branch* node = Unique<Branch>(slot);
+            if (PopTail(node->children[index], level - kBits)) {
+                node->children[index].Reset();
+                return index == 0;
+            }
+            return false;
+        }
+        if (index == 0) {
+            return true;
+        }
+        Unique<Branch>(slot)->children[index].Reset();
+        return false;
+    }
+
+    size_t size_ = 0;
+    size_t shift_ = kBits;
+    IntrusivePtr<Node> root_;
+    IntrusivePtr<Node> tail_;
+};
+
+template <typename T>
+void PersistentVector<T>::NodeDelete::Destroy(Node* node) {
+    if (node->is_leaf) {
+        delete static_cast<Leaf*>(node);
+    } else {
+        delete static_cast<Branch*>(node);
+    }
+}
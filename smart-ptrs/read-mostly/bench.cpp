@@ -0,0 +1,100 @@
+#include "read_mostly.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Reader scaling: every thread reads a config field while a writer publishes a new
+// version from time to time. Run with `test_read_mostly [bench]`.
+
+namespace {
+
+struct Flags {
+    int value = 0;
+};
+
+constexpr int kReadsPerThread = 1 << 22;
+
+template <typename Holder, typename ReadFn, typename WriteFn>
+double MeasureMops(int threads, Holder& holder, ReadFn read, WriteFn write) {
+    std::atomic<bool> start = false;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < threads; ++i) {
+        readers.emplace_back([&] {
+            while (!start.load()) {
+            }
+            int64_t sum = 0;
+            for (int j = 0; j < kReadsPerThread; ++j) {
+                sum += read(holder);
+            }
+            (void)sum;
+        });
+    }
+    std::thread writer([&] {
+        for (int i = 0; !done.load(); ++i) {
+            write(holder, i);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    done = true;
+    writer.join();
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return threads * static_cast<double>(kReadsPerThread) / seconds / 1e6;
+}
+
+struct LockedHolder {
+    std::mutex mutex;
+    std::shared_ptr<Flags> ptr = std::make_shared<Flags>();
+};
+
+}  // namespace
+
+TEST_CASE("ReadMostly reader scaling", "[.bench]") {
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "threads\tReadMostly\tmutex+shared_ptr\tatomic<shared_ptr>  (Mreads/s)\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        ReadMostly<Flags> holder(MakeShared<Flags>());
+        double rcu_mops = MeasureMops(
+            threads, holder, [](auto& holder) { return holder.Read()->value; },
+            [](auto& holder, int i) { holder.Emplace(Flags{i}); });
+
+        LockedHolder locked;
+        double locked_mops = MeasureMops(
+            threads, locked,
+            [](auto& holder) {
+                std::shared_ptr<Flags> snapshot;
+                {
+                    std::lock_guard guard(holder.mutex);
+                    snapshot = holder.ptr;
+                }
+                return snapshot->value;
+            },
+            [](auto& holder, int i) {
+                auto fresh = std::make_shared<Flags>(Flags{i});
+                std::lock_guard guard(holder.mutex);
+                holder.ptr = std::move(fresh);
+            });
+
+        std::atomic<std::shared_ptr<Flags>> atomic_holder(std::make_shared<Flags>());
+        double atomic_mops = MeasureMops(
+            threads, atomic_holder, [](auto& holder) { return holder.load()->value; },
+            [](auto& holder, int i) { holder.store(std::make_shared<Flags>(Flags{i})); });
+
+        std::cout << threads << '\t' << rcu_mops << "\t\t" << locked_mops << "\t\t\t"
+                  << atomic_mops << '\n';
+    }
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <weak/shared.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Read-copy-update holder for rarely updated, frequently read values (configs,
+// feature flags).
+//
+// Writers publish a new SharedPtr version. Every reader thread keeps its own cached
+// copy of the current version, validated by a global version number: a Read() that
+// finds its cache up to date loads that number and bumps a guard counter in its own
+// slot, without touching the control block or any other shared cache line. Reader
+// throughput therefore scales with the number of cores.
+//
+// A stale cache is refreshed on the next Read() of that thread, under the writer
+// mutex. A writer drops the caches of threads that hold no guard right away, so an
+// old version is freed once the last guard on it is gone, even if some thread never
+// reads again. The guard counter is what makes this safe: a reader publishes it
+// before checking the version, the writer checks it after bumping the version, and
+// a fence on both sides makes one of them always see the other. The fence is
+// asymmetric: readers only stop the compiler, and the writer makes every running
+// thread of the process execute a full barrier (membarrier(2)). Where membarrier is
+// unavailable both sides use a seq_cst fence.
+//
+// Each thread finds its slot through a thread_local table indexed by the holder id.
+// Ids are dense and reused after a holder dies, so the table is as long as the
+// largest number of holders alive at once; a serial number tells a new holder apart
+// from a dead one with the same id. When a thread exits, its slots go back to their
+// holders and are reused by new threads.
+template <typename T>
+class ReadMostly {
+    struct alignas(64) Slot {
+        SharedPtr<T> cached;
+        // 0 if `cached` was dropped by a writer.
+        std::atomic<uint64_t> version = 0;
+        // Written only by the owner thread.
+        std::atomic<size_t> active_guards = 0;
+    };
+
+public:
+    // Borrowed view of the calling thread's cached version. Must not be passed to
+    // another thread; while any guard is alive the thread keeps reading that version.
+    class ReadGuard {
+        friend class ReadMostly;
+
+    public:
+        ReadGuard(const ReadGuard& other) = delete;
+        ReadGuard& operator=(const ReadGuard& other) = delete;
+
+        ~ReadGuard() {
+            size_t guards = slot_->active_guards.load(std::memory_order_relaxed);
+            slot_->active_guards.store(guards - 1, std::memory_order_release);
+        }
+
+        const T* Get() const {
+            return slot_->cached.Get();
+        }
+        const T& operator*() const {
+            return *Get();
+        }
+        const T* operator->() const {
+            return Get();
+        }
+        explicit operator bool() const {
+            return Get() != nullptr;
+        }
+
+    private:
+        // `slot` is already pinned by Read().
+        explicit ReadGuard(Slot* slot) : slot_(slot) {
+        }
+
+        Slot* slot_;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ReadMostly() {
+    }
+    explicit ReadMostly(SharedPtr<T> value) : current_(std::move(value)) {
+    }
+
+    ReadMostly(const ReadMostly& other) = delete;
+    ReadMostly& operator=(const ReadMostly& other) = delete;
+
+    // No thread may be reading. Slots of this holder in thread tables turn stale.
+    ~ReadMostly() {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.holders[registration_.id] = nullptr;
+        registry.free_ids.push_back(registration_.id);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Readers
+
+    ReadGuard Read() const {
+        Slot* slot = LocalSlot();
+        size_t guards = slot->active_guards.load(std::memory_order_relaxed);
+        slot->active_guards.store(guards + 1, std::memory_order_relaxed);
+        LightFence();
+        uint64_t version = version_.load(std::memory_order_seq_cst);
+        if (guards == 0 && slot->version.load(std::memory_order_relaxed) != version) {
+            try {
+                std::lock_guard guard(mutex_);
+                slot->cached = current_;
+                slot->version.store(version_.load(std::memory_order_relaxed),
+                                    std::memory_order_relaxed);
+            } catch (...) {
+                slot->active_guards.store(guards, std::memory_order_release);
+                throw;
+            }
+        }
+        return ReadGuard(slot);
+    }
+
+    uint64_t Version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Writers
+
+    void Publish(SharedPtr<T> value) {
+        std::lock_guard guard(mutex_);
+        DoPublish(std::move(value));
+    }
+
+    template <typename... Args>
+    void Emplace(Args&&... args) {
+        Publish(MakeShared<T>(std::forward<Args>(args)...));
+    }
+
+    // Publishes `f(current)` (current is nullptr if nothing was published yet).
+    // Writers calling Update are serialized, so read-modify-write is not lost.
+    template <typename F>
+    void Update(F&& f) {
+        std::lock_guard guard(mutex_);
+        DoPublish(MakeShared<T>(f(static_cast<const T*>(current_.Get()))));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Slots handed out to reader threads, including free ones left by exited threads.
+    size_t NumSlots() const {
+        std::lock_guard guard(mutex_);
+        return slots_.size();
+    }
+
+private:
+    // Holders of one T by id, for threads that exit.
+    struct Registry {
+        std::mutex mutex;
+        std::vector<const ReadMostly*> holders;
+        std::vector<uint32_t> free_ids;
+        uint64_t last_serial = 0;
+    };
+
+    struct TableEntry {
+        uint64_t serial = 0;
+        Slot* slot = nullptr;
+    };
+
+    // Slots of the calling thread by holder id.
+    struct ThreadTable {
+        ~ThreadTable() {
+            Registry& registry = GetRegistry();
+            std::lock_guard guard(registry.mutex);
+            for (size_t id = 0; id < entries.size(); ++id) {
+                const ReadMostly* holder = id < registry.holders.size() ? registry.holders[id]
+                                                                        : nullptr;
+                if (holder && holder->registration_.serial == entries[id].serial) {
+                    holder->ReturnSlot(entries[id].slot);
+                }
+            }
+        }
+
+        std::vector<TableEntry> entries;
+    };
+
+    static Registry& GetRegistry() {
+        // Never destroyed: threads may exit during static destruction.
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    static ThreadTable& LocalTable() {
+        thread_local ThreadTable table;
+        return table;
+    }
+
+    // Set during static initialization; a holder used before that takes the
+    // seq_cst fences.
+#ifdef __linux__
+    static inline const bool kHasMembarrier =
+        syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+    static constexpr bool kHasMembarrier = false;
+#endif
+
+    static void LightFence() {
+        if (kHasMembarrier) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    static void HeavyFence() {
+#ifdef __linux__
+        if (kHasMembarrier) {
+            syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            return;
+        }
+#endif
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void DoPublish(SharedPtr<T> value) {
+        current_ = std::move(value);
+        version_.fetch_add(1, std::memory_order_seq_cst);
+        HeavyFence();
+        // A reader that pins its slot after this check sees the new version and
+        // refreshes under the mutex.
+        for (Slot& slot : slots_) {
+            if (slot.cached && slot.active_guards.load(std::memory_order_acquire) == 0) {
+                slot.cached.Reset();
+                slot.version.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Slot* LocalSlot() const {
+        auto [id, serial] = registration_;
+        auto& entries = LocalTable().entries;
+        if (id < entries.size() && entries[id].serial == serial) {
+            return entries[id].slot;
+        }
+        Slot* slot;
+        {
+            std::lock_guard guard(mutex_);
+            if (free_slots_.empty()) {
+                slot = &slots_.emplace_back();
+            } else {
+                slot = free_slots_.back();
+                free_slots_.pop_back();
+            }
+        }
+        if (id >= entries.size()) {
+            entries.resize(id + 1);
+        }
+        entries[id] = TableEntry{serial, slot};
+        return slot;
+    }
+
+    // Called by an exiting thread.
+    void ReturnSlot(Slot* slot) const {
+        SharedPtr<T> cached;
+        std::lock_guard guard(mutex_);
+        cached = std::move(slot->cached);
+        slot->version.store(0, std::memory_order_relaxed);
+        free_slots_.push_back(slot);
+    }
+
+    struct Registration {
+        uint32_t id;
+        uint64_t serial;
+    };
+
+    static Registration Register(const ReadMostly* holder) {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        uint32_t id;
+        if (registry.free_ids.empty()) {
+            id = registry.holders.size();
+            registry.holders.push_back(holder);
+        } else {
+            id = registry.free_ids.back();
+            registry.free_ids.pop_back();
+            registry.holders[id] = holder;
+        }
+        return Registration{id, ++registry.last_serial};
+    }
+
+    const Registration registration_ = Register(this);
+    alignas(64) std::atomic<uint64_t> version_ = 1;
+    mutable std::mutex mutex_;
+    SharedPtr<T> current_;
+    mutable std::deque<Slot> slots_;
+    mutable std::vector<Slot*> free_slots_;
+};
@@ -0,0 +1,162 @@
+#include "read_mostly.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Config {
+    Config(int version, std::string name) : version(version), name(std::move(name)) {
+        ++alive;
+    }
+    Config(const Config& other) : version(other.version), name(other.name) {
+        ++alive;
+    }
+    ~Config() {
+        --alive;
+    }
+
+    int version;
+    std::string name;
+
+    static inline std::atomic<int> alive = 0;
+};
+
+}  // namespace
+
+TEST_CASE("ReadMostly basics") {
+    ReadMostly<Config> holder;
+    REQUIRE(!holder.Read());
+
+    holder.Emplace(1, "first");
+    {
+        auto config = holder.Read();
+        REQUIRE(config->version == 1);
+        REQUIRE((*config).name == "first");
+    }
+
+    holder.Update([](const Config* old) { return Config(old->version + 1, old->name + "!"); });
+    auto config = holder.Read();
+    REQUIRE(config->version == 2);
+    REQUIRE(config->name == "first!");
+}
+
+TEST_CASE("ReadMostly guard pins its version") {
+    REQUIRE(Config::alive == 0);
+    {
+        ReadMostly<Config> holder(MakeShared<Config>(1, "a"));
+        auto outer = holder.Read();
+        holder.Emplace(2, "b");
+        REQUIRE(Config::alive == 2);
+
+        // Nested guards keep seeing the version the thread started with.
+        auto inner = holder.Read();
+        REQUIRE(inner.Get() == outer.Get());
+        REQUIRE(inner->version == 1);
+    }
+    REQUIRE(Config::alive == 0);
+}
+
+TEST_CASE("ReadMostly reclaims old versions") {
+    ReadMostly<Config> holder(MakeShared<Config>(0, ""));
+    for (int i = 1; i <= 100; ++i) {
+        holder.Emplace(i, "");
+        REQUIRE(holder.Read()->version == i);
+    }
+    // The current version plus nothing else: the thread cache was refreshed.
+    REQUIRE(Config::alive == 1);
+
+    std::thread exited([&] { (void)holder.Read(); });
+    exited.join();
+    holder.Emplace(101, "");
+    // The exited thread gave its cache back.
+    REQUIRE(Config::alive == 1);
+    REQUIRE(holder.Read()->version == 101);
+}
+
+TEST_CASE("ReadMostly releases idle caches") {
+    ReadMostly<Config> holder(MakeShared<Config>(0, ""));
+    std::atomic<int> step = 0;
+    std::atomic<int> last_read = -1;
+    std::thread idle([&] {
+        (void)holder.Read();
+        step = 1;
+        while (step != 2) {
+            std::this_thread::yield();
+        }
+        last_read = holder.Read()->version;
+    });
+    while (step != 1) {
+        std::this_thread::yield();
+    }
+    // The idle thread holds no guard, so the writer drops its cache.
+    holder.Emplace(1, "");
+    REQUIRE(Config::alive == 1);
+    step = 2;
+    idle.join();
+    REQUIRE(last_read == 1);
+    REQUIRE(Config::alive == 1);
+}
+
+TEST_CASE("ReadMostly reuses slots of exited threads") {
+    ReadMostly<int> holder(MakeShared<int>(1));
+    for (int i = 0; i < 100; ++i) {
+        std::thread reader([&] { (void)holder.Read(); });
+        reader.join();
+    }
+    REQUIRE(holder.NumSlots() == 1);
+}
+
+TEST_CASE("ReadMostly holders do not share thread caches") {
+    auto first = std::make_unique<ReadMostly<int>>(MakeShared<int>(1));
+    REQUIRE(*first->Read() == 1);
+    first.reset();
+    ReadMostly<int> second(MakeShared<int>(2));
+    REQUIRE(*second.Read() == 2);
+
+    // Ids of dead holders are reused.
+    for (int i = 0; i < 1000; ++i) {
+        ReadMostly<int> holder(MakeShared<int>(i));
+        REQUIRE(*holder.Read() == i);
+    }
+    REQUIRE(*second.Read() == 2);
+}
+
+TEST_CASE("ReadMostly concurrent readers") {
+    constexpr int kReaders = 4;
+    constexpr int kVersions = 200;
+
+    ReadMostly<Config> holder(MakeShared<Config>(0, "0"));
+    std::atomic<bool> done = false;
+    std::atomic<bool> ok = true;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < kReaders; ++i) {
+        readers.emplace_back([&] {
+            int last = 0;
+            while (!done.load()) {
+                auto config = holder.Read();
+                // Versions only move forward and are never torn.
+                if (config->version < last || config->name != std::to_string(config->version)) {
+                    ok = false;
+                }
+                last = config->version;
+            }
+        });
+    }
+    for (int i = 1; i <= kVersions; ++i) {
+        holder.Emplace(i, std::to_string(i));
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    REQUIRE(ok);
+    REQUIRE(holder.Read()->version == kVersions);
+}
@@ -0,0 +1,90 @@
+#include "hazard.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lock() throughput on a shared cache slot while a writer keeps replacing the cached
+// object. Run with `test_reclaim [bench]`.
+
+namespace {
+
+struct Payload {
+    int value = 0;
+};
+
+constexpr int kLocksPerThread = 1 << 20;
+
+struct LockedSlot {
+    SharedPtr<Payload> Lock() {
+        std::lock_guard guard(mutex);
+        return weak.Lock();
+    }
+    void Store(const SharedPtr<Payload>& value) {
+        std::lock_guard guard(mutex);
+        weak = value;
+    }
+
+    std::mutex mutex;
+    WeakPtr<Payload> weak;
+};
+
+template <typename Slot>
+double MeasureMops(int threads, Slot& slot) {
+    std::atomic<bool> start = false;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < threads; ++i) {
+        readers.emplace_back([&] {
+            while (!start.load()) {
+            }
+            int64_t sum = 0;
+            for (int j = 0; j < kLocksPerThread; ++j) {
+                if (auto value = slot.Lock()) {
+                    sum += value->value;
+                }
+            }
+            (void)sum;
+        });
+    }
+    std::thread writer([&] {
+        auto owner = MakeShared<Payload>();
+        for (int i = 0; !done.load(); ++i) {
+            owner = MakeShared<Payload>(Payload{i});
+            slot.Store(owner);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    done = true;
+    writer.join();
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return threads * static_cast<double>(kLocksPerThread) / seconds / 1e6;
+}
+
+}  // namespace
+
+TEST_CASE("WeakSlot lock throughput", "[.bench]") {
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "threads\tWeakSlot\tmutex+WeakPtr  (Mlocks/s)\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        WeakSlot<Payload> slot;
+        double hazard_mops = MeasureMops(threads, slot);
+
+        LockedSlot locked;
+        double locked_mops = MeasureMops(threads, locked);
+
+        std::cout << threads << '\t' << hazard_mops << "\t\t" << locked_mops << '\n';
+    }
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <intrusive/intrusive.h>
+#include <weak/shared.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Epoch-based reclamation.
+//
+// Readers of a concurrent structure (an intrusive list, a hash map) traverse nodes
+// inside a critical section: `EbrGuard guard;`. A writer that unlinks a node drops
+// its reference as usual, but the final DecRef/DecStrongRefCnt retires the object
+// into the current epoch instead of freeing it: a reader that is still looking at
+// the node keeps it alive.
+//
+// The global epoch advances only when every thread inside a critical section has
+// observed it. Anything retired in epoch `e` is unreachable for readers that entered
+// after `e`, so it is freed once the global epoch reaches `e + 2`. Retired objects
+// are collected in batches of kBatch per thread.
+//
+// Plug-ins:
+//  * RefCounted<T, Counter, EbrDelete<>> retires the object on the last DecRef;
+//  * MakeSharedEbr / AdoptSharedEbr create SharedPtr control blocks (ControlBlockMakeShared,
+//    ControlBlockNew) that retire both the object and the block.
+class EbrDomain {
+public:
+    static constexpr size_t kBatch = 64;
+
+    static EbrDomain& Instance() {
+        static EbrDomain domain;
+        return domain;
+    }
+
+    EbrDomain(const EbrDomain& other) = delete;
+    EbrDomain& operator=(const EbrDomain& other) = delete;
+
+    ~EbrDomain() {
+        // Every thread has left by now; whatever reclaiming retires is freed at once.
+        shutting_down_ = true;
+        for (auto* list : {&ready_orphans_, &orphans_}) {
+            for (const auto& retired : std::exchange(*list, {})) {
+                retired.reclaim(retired.object);
+            }
+        }
+    }
+
+    // Critical sections nest.
+    void Enter() {
+        if (record_gone_) {
+            late_readers_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return;
+        }
+        ThreadRecord& record = Local();
+        if (record.nesting++ == 0) {
+            record.local.store((global_epoch_.load() << 1) | 1);
+            // Either the next advance sees us, or our reads see every unlink before it.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    void Leave() {
+        if (record_gone_) {
+            late_readers_.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        ThreadRecord& record = Local();
+        if (--record.nesting == 0) {
+            record.local.store(0, std::memory_order_release);
+        }
+    }
+
+    void Retire(void* object, void (*reclaim)(void*)) {
+        if (shutting_down_) {
+            reclaim(object);
+            return;
+        }
+        if (record_gone_) {
+            std::lock_guard guard(mutex_);
+            orphans_.push_back({object, reclaim, global_epoch_.load()});
+            return;
+        }
+        ThreadRecord& record = Local();
+        // The object is unlinked before this load, hence before the next advance.
+        record.limbo.push_back({object, reclaim, global_epoch_.load()});
+        if (record.limbo.size() >= record.next_collect) {
+            Collect(record);
+            // Objects pinned by a long critical section do not make every Retire scan.
+            record.next_collect = record.limbo.size() + kBatch;
+        }
+    }
+
+    // Tries to advance the epoch and frees what the calling thread retired long enough
+    // ago. Two calls outside of any critical section free everything retired before,
+    // unless other threads stay inside their critical sections.
+    void Collect() {
+        if (record_gone_) {
+            TryAdvance();
+            ReclaimReadyOrphans();
+            return;
+        }
+        ThreadRecord& record = Local();
+        Collect(record);
+        record.next_collect = record.limbo.size() + kBatch;
+    }
+
+    // Retired by the calling thread and not freed yet.
+    size_t NumRetired() {
+        return record_gone_ ? 0 : Local().limbo.size();
+    }
+    uint64_t Epoch() const {
+        return global_epoch_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Retired {
+        void* object;
+        void (*reclaim)(void*);
+        uint64_t epoch;
+    };
+
+    struct ThreadRecord {
+        explicit ThreadRecord(EbrDomain* domain) : domain(domain) {
+            std::lock_guard guard(domain->mutex_);
+            domain->records_.push_back(this);
+        }
+
+        ~ThreadRecord() {
+            domain->Collect(*this);
+            // From here on the thread retires straight into the orphans.
+            record_gone_ = true;
+            std::lock_guard guard(domain->mutex_);
+            std::erase(domain->records_, this);
+            // Whatever is still pinned is freed by the domain.
+            domain->orphans_.insert(domain->orphans_.end(), limbo.begin(), limbo.end());
+        }
+
+        EbrDomain* domain;
+        // (epoch << 1) | 1 inside a critical section, 0 outside.
+        std::atomic<uint64_t> local = 0;
+        size_t nesting = 0;
+        std::vector<Retired> limbo;
+        size_t next_collect = kBatch;
+        bool collecting = false;
+    };
+
+    EbrDomain() {
+    }
+
+    // Set once the record of the thread is destroyed, for thread_local destructors
+    // that run later. Trivially destructible, so it outlives the record.
+    static inline thread_local bool record_gone_ = false;
+
+    ThreadRecord& Local() {
+        thread_local ThreadRecord record(this);
+        return record;
+    }
+
+    bool TryAdvance() {
+        std::lock_guard guard(mutex_);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Readers without a record pin the current epoch.
+        if (late_readers_.load() != 0) {
+            return false;
+        }
+        uint64_t epoch = global_epoch_.load();
+        for (const ThreadRecord* record : records_) {
+            uint64_t local = record->local.load();
+            if ((local & 1) && (local >> 1) != epoch) {
+                return false;
+            }
+        }
+        global_epoch_.store(epoch + 1);
+        if (!orphans_.empty()) {
+            // Orphans are freed by whoever advances the epoch next: they are old enough
+            // once two more epochs have passed, so hand them over then.
+            std::erase_if(orphans_, [&](const Retired& retired) {
+                if (retired.epoch + 2 <= epoch + 1) {
+                    ready_orphans_.push_back(retired);
+                    return true;
+                }
+                return false;
+            });
+        }
+        return true;
+    }
+
+    void Collect(ThreadRecord& record) {
+        if (record.collecting) {
+            return;
+        }
+        record.collecting = true;
+        TryAdvance();
+        uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+
+        std::vector<Retired> ready;
+        std::erase_if(record.limbo, [&](const Retired& retired) {
+            if (retired.epoch + 2 <= epoch) {
+                ready.push_back(retired);
+                return true;
+            }
+            return false;
+        });
+        // Reclaiming may retire more objects (destructors drop references).
+        for (const auto& retired : ready) {
+            retired.reclaim(retired.object);
+        }
+        ReclaimReadyOrphans();
+        record.collecting = false;
+    }
+
+    void ReclaimReadyOrphans() {
+        std::vector<Retired> ready;
+        {
+            std::lock_guard guard(mutex_);
+            ready.swap(ready_orphans_);
+        }
+        for (const auto& retired : ready) {
+            retired.reclaim(retired.object);
+        }
+    }
+
+    std::atomic<uint64_t> global_epoch_ = 0;
+    // Critical sections of threads whose record is gone.
+    std::atomic<size_t> late_readers_ = 0;
+    std::mutex mutex_;
+    std::vector<ThreadRecord*> records_;
+    std::vector<Retired> orphans_;
+    std::vector<Retired> ready_orphans_;
+    bool shutting_down_ = false;
+};
+
+class EbrGuard {
+public:
+    EbrGuard() {
+        EbrDomain::Instance().Enter();
+    }
+
+    EbrGuard(const EbrGuard& other) = delete;
+    EbrGuard& operator=(const EbrGuard& other) = delete;
+
+    ~EbrGuard() {
+        EbrDomain::Instance().Leave();
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RefCounted
+
+// Deleter that retires the object; `Inner` destroys it after the grace period.
+template <typename Inner = DefaultDelete>
+struct EbrDelete {
+    EbrDelete() {
+    }
+    explicit EbrDelete(Inner inner) : inner(std::move(inner)) {
+    }
+
+    template <typename T>
+    void Destroy(T* object) {
+        if constexpr (std::is_empty_v<Inner>) {
+            EbrDomain::Instance().Retire(object, [](void* retired) {
+                Inner temp_deleter;
+                temp_deleter.Destroy(static_cast<T*>(retired));
+            });
+        } else {
+            // A stateful deleter dies with the object: it waits in a record of its own.
+            auto record = new Retired<T>{object, std::move(inner)};
+            EbrDomain::Instance().Retire(record, [](void* retired) {
+                auto record = static_cast<Retired<T>*>(retired);
+                record->inner.Destroy(record->object);
+                delete record;
+            });
+        }
+    }
+
+    [[no_unique_address]] Inner inner;
+
+private:
+    template <typename T>
+    struct Retired {
+        T* object;
+        Inner inner;
+    };
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SharedPtr
+
+struct EbrReclaim {
+    static void Retire(void* block, void (*reclaim)(void*)) {
+        EbrDomain::Instance().Retire(block, reclaim);
+    }
+};
+
+template <typename T, typename... Args>
+SharedPtr<T> MakeSharedEbr(Args&&... args) {
+    T* ptr = nullptr;
+    auto block = new ControlBlockMakeShared<T, EbrReclaim>(ptr, std::forward<Args>(args)...);
+    return SharedPtr<T>(block, ptr);
+}
+
+template <typename T>
+SharedPtr<T> AdoptSharedEbr(T* ptr) {
+    return SharedPtr<T>(new ControlBlockNew<T, EbrReclaim>(ptr), ptr);
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <weak/weak.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Hazard pointers.
+//
+// Before dereferencing a pointer read from a shared location, a thread publishes it
+// in one of its hazard slots and checks that the location still holds it. A retired
+// object is only freed by a scan that finds it in no hazard slot.
+//
+// Every thread owns one record with kSlotsPerThread slots; records are reused after
+// a thread exits, so their number is bounded by the peak number of threads. Retired
+// objects are kept per thread and scanned in batches: once the list grows by the
+// scan threshold (SetScanThreshold) since the last scan. A scan frees everything but
+// the at most H = kSlotsPerThread * records objects that are still protected, so
+// every thread holds at most H + threshold retired objects.
+class HazardDomain {
+public:
+    static constexpr size_t kSlotsPerThread = 2;
+    static constexpr size_t kDefaultScanThreshold = 64;
+
+    static HazardDomain& Instance() {
+        static HazardDomain domain;
+        return domain;
+    }
+
+    HazardDomain(const HazardDomain& other) = delete;
+    HazardDomain& operator=(const HazardDomain& other) = delete;
+
+    ~HazardDomain() {
+        // Every thread has left by now.
+        for (const auto& retired : orphans_) {
+            retired.reclaim(retired.object);
+        }
+        for (Record* record = records_.load(); record;) {
+            delete std::exchange(record, record->next);
+        }
+    }
+
+    // One protected pointer; releases its slot on destruction.
+    class Guard {
+    public:
+        Guard() : slot_(Instance().AcquireSlot()) {
+        }
+
+        Guard(const Guard& other) = delete;
+        Guard& operator=(const Guard& other) = delete;
+
+        ~Guard() {
+            slot_->store(nullptr, std::memory_order_release);
+            Instance().ReleaseSlot(slot_);
+        }
+
+        // Returns the current value of `source`, safe to dereference while this guard
+        // protects it (until the next Protect or the guard's destruction).
+        template <typename P>
+        P* Protect(const std::atomic<P*>& source) {
+            P* ptr = source.load(std::memory_order_relaxed);
+            while (true) {
+                slot_->store(ptr);
+                P* again = source.load();
+                if (again == ptr) {
+                    return ptr;
+                }
+                ptr = again;
+            }
+        }
+
+    private:
+        std::atomic<void*>* slot_;
+    };
+
+    // `object` must already be unreachable for new readers.
+    void Retire(void* object, void (*reclaim)(void*)) {
+        Local& local = GetLocal();
+        local.retired.push_back({object, reclaim});
+        if (local.retired.size() >= local.next_scan) {
+            Scan(local);
+        }
+    }
+
+    void SetScanThreshold(size_t threshold) {
+        scan_threshold_.store(std::max<size_t>(threshold, 1), std::memory_order_relaxed);
+    }
+    size_t ScanThreshold() const {
+        return scan_threshold_.load(std::memory_order_relaxed);
+    }
+
+    // Frees every retired object of the calling thread that is not protected.
+    void Scan() {
+        Scan(GetLocal());
+    }
+
+    // Retired by the calling thread and not freed yet.
+    size_t NumRetired() {
+        return GetLocal().retired.size();
+    }
+    size_t NumRecords() const {
+        return num_records_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Retired {
+        void* object;
+        void (*reclaim)(void*);
+    };
+
+    struct Record {
+        std::atomic<void*> slots[kSlotsPerThread] = {};
+        std::atomic<bool> in_use = true;
+        Record* next = nullptr;
+    };
+
+    struct Local {
+        explicit Local(HazardDomain* domain) : domain(domain), record(domain->AcquireRecord()) {
+        }
+
+        ~Local() {
+            domain->Scan(*this);
+            {
+                std::lock_guard guard(domain->mutex_);
+                domain->orphans_.insert(domain->orphans_.end(), retired.begin(), retired.end());
+            }
+            record->in_use.store(false, std::memory_order_release);
+        }
+
+        HazardDomain* domain;
+        Record* record;
+        unsigned used_slots = 0;
+        std::vector<Retired> retired;
+        size_t next_scan = kDefaultScanThreshold;
+        bool scanning = false;
+    };
+
+    HazardDomain() {
+    }
+
+    Local& GetLocal() {
+        thread_local Local local(this);
+        return local;
+    }
+
+    Record* AcquireRecord() {
+        for (Record* record = records_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            bool free = false;
+            if (record->in_use.compare_exchange_strong(free, true)) {
+                return record;
+            }
+        }
+        auto record = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record)) {
+        }
+        num_records_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    std::atomic<void*>* AcquireSlot() {
+        Local& local = GetLocal();
+        for (size_t i = 0; i < kSlotsPerThread; ++i) {
+            if (!(local.used_slots & (1u << i))) {
+                local.used_slots |= 1u << i;
+                return &local.record->slots[i];
+            }
+        }
+        assert(false && "Too many hazard guards in one thread");
+        std::abort();
+    }
+    void ReleaseSlot(std::atomic<void*>* slot) {
+        Local& local = GetLocal();
+        local.used_slots &= ~(1u << (slot - local.record->slots));
+    }
+
+    void Scan(Local& local) {
+        if (local.scanning) {
+            return;
+        }
+        local.scanning = true;
+
+        std::vector<Retired> candidates;
+        candidates.swap(local.retired);
+        {
+            std::lock_guard guard(mutex_);
+            candidates.insert(candidates.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+        }
+
+        // Pairs with the store-then-reload in Guard::Protect.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<void*> hazards;
+        for (Record* record = records_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            for (const auto& slot : record->slots) {
+                if (void* ptr = slot.load()) {
+                    hazards.push_back(ptr);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        std::vector<Retired> ready;
+        for (const auto& retired : candidates) {
+            if (std::binary_search(hazards.begin(), hazards.end(), retired.object)) {
+                local.retired.push_back(retired);
+            } else {
+                ready.push_back(retired);
+            }
+        }
+        local.next_scan = local.retired.size() + ScanThreshold();
+        // Reclaiming may retire more objects.
+        for (const auto& retired : ready) {
+            retired.reclaim(retired.object);
+        }
+        local.scanning = false;
+    }
+
+    std::atomic<Record*> records_ = nullptr;
+    std::atomic<size_t> num_records_ = 0;
+    std::atomic<size_t> scan_threshold_ = kDefaultScanThreshold;
+    std::mutex mutex_;
+    std::vector<Retired> orphans_;
+};
+
+// Shared cache slot holding a WeakPtr that threads Lock() and Store() concurrently.
+//
+// The slot points to an immutable box with a WeakPtr inside. Lock() protects the box
+// with a hazard pointer, so the box (and through its weak reference the control
+// block) stays alive while the strong counter is incremented, even if another thread
+// replaces the box at the same moment. A replaced box is retired into HazardDomain.
+template <typename T>
+class WeakSlot {
+    struct Box {
+        WeakPtr<T> weak;
+    };
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    WeakSlot() {
+    }
+    explicit WeakSlot(const SharedPtr<T>& value) : box_(new Box{WeakPtr<T>(value)}) {
+    }
+
+    WeakSlot(const WeakSlot& other) = delete;
+    WeakSlot& operator=(const WeakSlot& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~WeakSlot() {
+        // Nobody uses the slot any more, but a reader may still hold the last box.
+        Retire(box_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Operations
+
+    SharedPtr<T> Lock() const {
+        HazardDomain::Guard guard;
+        Box* box = guard.Protect(box_);
+        if (!box) {
+            return SharedPtr<T>();
+        }
+        return box->weak.Lock();
+    }
+
+    void Store(const SharedPtr<T>& value) {
+        Retire(box_.exchange(value ? new Box{WeakPtr<T>(value)} : nullptr));
+    }
+    void Store(const WeakPtr<T>& value) {
+        Retire(box_.exchange(new Box{value}));
+    }
+    void Reset() {
+        Retire(box_.exchange(nullptr));
+    }
+
+private:
+    static void Retire(Box* box) {
+        if (box) {
+            HazardDomain::Instance().Retire(box, [](void* retired) {
+                delete static_cast<Box*>(retired);
+            });
+        }
+    }
+
+    std::atomic<Box*> box_ = nullptr;
+};
@@ -0,0 +1,209 @@
+#include "ebr.h"
+
+#include <weak/weak.h>
+
+#include <catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tracked {
+    static constexpr uint64_t kAlive = 0xA11CE;
+
+    explicit Tracked(int value = 0) : value(value) {
+        ++created;
+    }
+    ~Tracked() {
+        magic = 0;
+        ++destroyed;
+    }
+
+    int value;
+    uint64_t magic = kAlive;
+
+    static inline std::atomic<int> created = 0;
+    static inline std::atomic<int> destroyed = 0;
+};
+
+struct Node : Tracked, AtomicRefCounted<Node, EbrDelete<>> {
+    using Tracked::Tracked;
+};
+
+// Stateful inner deleter: counts the objects it destroyed.
+struct CountingDelete {
+    template <typename T>
+    void Destroy(T* object) {
+        delete object;
+        ++*count;
+    }
+
+    std::atomic<int>* count = nullptr;
+};
+
+struct CountedNode : AtomicRefCounted<CountedNode, EbrDelete<CountingDelete>> {
+    explicit CountedNode(std::atomic<int>* count)
+        : AtomicRefCounted<CountedNode, EbrDelete<CountingDelete>>(
+              EbrDelete<CountingDelete>(CountingDelete{count})) {
+    }
+};
+
+// Reclaiming a destroyed object may retire its control block: a few more rounds.
+void CollectAll() {
+    auto& domain = EbrDomain::Instance();
+    for (int i = 0; i < 6; ++i) {
+        domain.Collect();
+    }
+}
+
+}  // namespace
+
+TEST_CASE("EbrDelete retires the object") {
+    Tracked::destroyed = 0;
+    auto& domain = EbrDomain::Instance();
+
+    auto node = MakeIntrusive<Node>(1);
+    node.Reset();
+    REQUIRE(Tracked::destroyed == 0);
+    REQUIRE(domain.NumRetired() == 1);
+    CollectAll();
+    REQUIRE(Tracked::destroyed == 1);
+    REQUIRE(domain.NumRetired() == 0);
+}
+
+TEST_CASE("EbrDelete keeps a stateful inner deleter") {
+    std::atomic<int> count = 0;
+    auto node = MakeIntrusive<CountedNode>(&count);
+    node.Reset();
+    REQUIRE(count == 0);
+    CollectAll();
+    REQUIRE(count == 1);
+}
+
+TEST_CASE("Retire after the thread record is gone") {
+    struct Holder {
+        IntrusivePtr<Node> node;
+    };
+    Tracked::destroyed = 0;
+    std::thread thread([] {
+        // Constructed before the EBR record, so destroyed after it.
+        thread_local Holder holder;
+        EbrGuard guard;
+        holder.node = MakeIntrusive<Node>(1);
+    });
+    thread.join();
+    REQUIRE(Tracked::destroyed == 0);
+    CollectAll();
+    REQUIRE(Tracked::destroyed == 1);
+}
+
+TEST_CASE("EbrGuard pins retired objects") {
+    Tracked::destroyed = 0;
+    auto& domain = EbrDomain::Instance();
+    {
+        EbrGuard guard;
+        auto node = MakeIntrusive<Node>(1);
+        Node* raw = node.Get();
+        node.Reset();
+        {
+            EbrGuard nested;
+            CollectAll();
+        }
+        CollectAll();
+        REQUIRE(Tracked::destroyed == 0);
+        REQUIRE(raw->magic == Tracked::kAlive);
+    }
+    CollectAll();
+    REQUIRE(Tracked::destroyed == 1);
+    REQUIRE(domain.NumRetired() == 0);
+}
+
+TEST_CASE("SharedPtr with EBR control blocks") {
+    Tracked::destroyed = 0;
+
+    SECTION("MakeSharedEbr") {
+        auto ptr = MakeSharedEbr<Tracked>(5);
+        WeakPtr<Tracked> weak = ptr;
+        auto copy = ptr;
+        ptr.Reset();
+        copy.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(Tracked::destroyed == 0);
+        CollectAll();
+        REQUIRE(Tracked::destroyed == 1);
+        // The block itself is retired once the last weak reference is gone.
+        weak.Reset();
+        REQUIRE(EbrDomain::Instance().NumRetired() == 1);
+        CollectAll();
+    }
+
+    SECTION("AdoptSharedEbr") {
+        auto ptr = AdoptSharedEbr(new Tracked(6));
+        REQUIRE(ptr->value == 6);
+        ptr.Reset();
+        REQUIRE(Tracked::destroyed == 0);
+        CollectAll();
+        REQUIRE(Tracked::destroyed == 1);
+    }
+
+    REQUIRE(EbrDomain::Instance().NumRetired() == 0);
+}
+
+TEST_CASE("EBR readers and writers") {
+    constexpr int kSlots = 8;
+    constexpr int kReaders = 3;
+    constexpr int kWrites = 20000;
+
+    Tracked::created = 0;
+    Tracked::destroyed = 0;
+
+    std::array<std::atomic<Node*>, kSlots> slots;
+    std::array<IntrusivePtr<Node>, kSlots> owners;
+    for (int i = 0; i < kSlots; ++i) {
+        owners[i] = MakeIntrusive<Node>(i);
+        slots[i] = owners[i].Get();
+    }
+
+    std::atomic<bool> done = false;
+    std::atomic<bool> ok = true;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < kReaders; ++i) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                EbrGuard guard;
+                for (auto& slot : slots) {
+                    Node* node = slot.load(std::memory_order_acquire);
+                    if (node->magic != Tracked::kAlive) {
+                        ok = false;
+                    }
+                }
+            }
+        });
+    }
+    std::thread writer([&] {
+        for (int i = 0; i < kWrites; ++i) {
+            int index = i % kSlots;
+            auto fresh = MakeIntrusive<Node>(i);
+            slots[index].store(fresh.Get(), std::memory_order_release);
+            owners[index] = std::move(fresh);
+        }
+    });
+    writer.join();
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    REQUIRE(ok);
+
+    for (auto& owner : owners) {
+        owner.Reset();
+    }
+    CollectAll();
+    REQUIRE(Tracked::created == Tracked::destroyed);
+}
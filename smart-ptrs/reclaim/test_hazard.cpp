@@ -0,0 +1,187 @@
+#include "hazard.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tracked {
+    static constexpr uint64_t kAlive = 0xA11CE;
+
+    explicit Tracked(int value = 0) : value(value) {
+        ++created;
+    }
+    ~Tracked() {
+        magic = 0;
+        ++destroyed;
+    }
+
+    int value;
+    uint64_t magic = kAlive;
+
+    static inline std::atomic<int> created = 0;
+    static inline std::atomic<int> destroyed = 0;
+};
+
+struct Box {
+    int value;
+};
+
+void Free(void* object) {
+    delete static_cast<Box*>(object);
+}
+
+}  // namespace
+
+TEST_CASE("Unprotected objects are freed by a scan") {
+    auto& domain = HazardDomain::Instance();
+    domain.Scan();
+    domain.Retire(new Box{1}, &Free);
+    domain.Retire(new Box{2}, &Free);
+    REQUIRE(domain.NumRetired() == 2);
+    domain.Scan();
+    REQUIRE(domain.NumRetired() == 0);
+}
+
+TEST_CASE("Protected objects survive scans") {
+    auto& domain = HazardDomain::Instance();
+    std::atomic<Box*> source = new Box{42};
+    {
+        HazardDomain::Guard guard;
+        Box* box = guard.Protect(source);
+        domain.Retire(source.exchange(nullptr), &Free);
+        domain.Scan();
+        domain.Scan();
+        REQUIRE(domain.NumRetired() == 1);
+        REQUIRE(box->value == 42);
+    }
+    domain.Scan();
+    REQUIRE(domain.NumRetired() == 0);
+}
+
+TEST_CASE("Scan threshold") {
+    auto& domain = HazardDomain::Instance();
+    domain.SetScanThreshold(8);
+    domain.Scan();
+    for (int i = 0; i < 7; ++i) {
+        domain.Retire(new Box{i}, &Free);
+    }
+    REQUIRE(domain.NumRetired() == 7);
+    domain.Retire(new Box{7}, &Free);
+    REQUIRE(domain.NumRetired() == 0);
+
+    // Retired memory stays bounded.
+    for (int i = 0; i < 1000; ++i) {
+        domain.Retire(new Box{i}, &Free);
+        REQUIRE(domain.NumRetired() < 8);
+    }
+    domain.SetScanThreshold(HazardDomain::kDefaultScanThreshold);
+    domain.Scan();
+}
+
+TEST_CASE("Records are reused") {
+    auto& domain = HazardDomain::Instance();
+    std::atomic<Box*> source = new Box{1};
+    domain.Scan();
+    size_t records = domain.NumRecords();
+    for (int i = 0; i < 16; ++i) {
+        std::thread([&] {
+            HazardDomain::Guard guard;
+            REQUIRE(guard.Protect(source)->value == 1);
+        }).join();
+    }
+    REQUIRE(domain.NumRecords() <= records + 1);
+    delete source.load();
+}
+
+TEST_CASE("WeakSlot") {
+    WeakSlot<Tracked> slot;
+    REQUIRE(!slot.Lock());
+
+    auto first = MakeShared<Tracked>(1);
+    slot.Store(first);
+    REQUIRE(slot.Lock().Get() == first.Get());
+    REQUIRE(first.UseCount() == 1);
+
+    auto second = MakeShared<Tracked>(2);
+    slot.Store(WeakPtr<Tracked>(second));
+    REQUIRE(slot.Lock()->value == 2);
+
+    second.Reset();
+    REQUIRE(!slot.Lock());
+
+    slot.Store(first);
+    slot.Reset();
+    REQUIRE(!slot.Lock());
+    HazardDomain::Instance().Scan();
+}
+
+TEST_CASE("WeakSlot stress") {
+    Tracked::created = 0;
+    Tracked::destroyed = 0;
+    constexpr int kReaders = 4;
+    constexpr int kWriters = 2;
+    constexpr int kIterations = 20000;
+    constexpr int kMinLocks = 1000;
+
+    std::atomic<bool> start = false;
+    std::atomic<bool> ok = true;
+    std::atomic<int> locked = 0;
+    {
+        WeakSlot<Tracked> slot(MakeShared<Tracked>(0));
+        std::atomic<int> writers_left = kWriters;
+        std::atomic<int> readers_left = kReaders;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kWriters; ++i) {
+            threads.emplace_back([&, i] {
+                while (!start.load()) {
+                    std::this_thread::yield();
+                }
+                // Keeps a few objects alive so that readers often succeed.
+                std::vector<SharedPtr<Tracked>> owners(4);
+                for (int j = 0; j < kIterations; ++j) {
+                    auto fresh = MakeShared<Tracked>(i * kIterations + j);
+                    slot.Store(fresh);
+                    owners[j % owners.size()] = std::move(fresh);
+                }
+                --writers_left;
+                // The last stored objects stay alive until every reader is done.
+                while (readers_left.load() > 0) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        for (int i = 0; i < kReaders; ++i) {
+            threads.emplace_back([&] {
+                while (!start.load()) {
+                    std::this_thread::yield();
+                }
+                // Writers may finish before a reader is scheduled at all.
+                for (int j = 0; j < kMinLocks || writers_left.load() > 0; ++j) {
+                    if (auto value = slot.Lock()) {
+                        if (value->magic != Tracked::kAlive) {
+                            ok = false;
+                        }
+                        ++locked;
+                    }
+                }
+                --readers_left;
+            });
+        }
+        start = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    HazardDomain::Instance().Scan();
+
+    REQUIRE(ok);
+    REQUIRE(locked > 0);
+    REQUIRE(Tracked::created == Tracked::destroyed);
+}
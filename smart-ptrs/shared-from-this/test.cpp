@@ -89,3 +89,21 @@ TEST_CASE("WeakFromThis") {
     REQUIRE(!weak.Expired());
     REQUIRE(weak.Lock().Get() == ptr);
 }
+
+struct Config : EnableSharedFromThis<Config> {
+    Config(int value) : value(value) {
+    }
+
+    int value;
+};
+
+TEST_CASE("Immortal SharedFromThis") {
+    static ImmortalShared<Config> config(42);
+
+    SharedPtr<Config> a = config.Get();
+    size_t count = a.UseCount();
+    SharedPtr<Config> b = a->SharedFromThis();
+    REQUIRE(b == a);
+    REQUIRE(b->value == 42);
+    REQUIRE(b.UseCount() == count);
+}
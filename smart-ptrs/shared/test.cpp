@@ -467,3 +467,38 @@ TEST_CASE("Destructor for correct type") {
         REQUIRE(B::destructor_called);
     }
 }
+
+TEST_CASE("Immortal") {
+    static ImmortalShared<std::string> empty("immortal");
+
+    EXPECT_ZERO_ALLOCATIONS(SharedPtr<std::string> a = empty.Get(); SharedPtr<std::string> b = a;
+                            REQUIRE(*b == "immortal"););
+
+    SharedPtr<std::string> a = empty.Get();
+    size_t count = a.UseCount();
+    {
+        std::vector<SharedPtr<std::string>> copies(100, a);
+        REQUIRE(a.UseCount() == count);
+    }
+    a.Reset();
+    REQUIRE(*empty.Get() == "immortal");
+}
+
+struct WeakPolicy : core::Policy<SimpleCounter, true> {};
+struct AtomicPolicy : core::Policy<AtomicCounter, false> {};
+
+TEST_CASE("Policies") {
+    // No WeakPtr support, no weak counter.
+    static_assert(sizeof(core::ControlBlockBase<SharedPolicy>) <
+                  sizeof(core::ControlBlockBase<WeakPolicy>));
+
+    SharedPtr<std::string, AtomicPolicy> a(new std::string("atomic"));
+    SharedPtr<std::string, AtomicPolicy> b = core::MakeShared<std::string, AtomicPolicy>("made");
+    {
+        auto c = a;
+        REQUIRE(a.UseCount() == 2);
+    }
+    REQUIRE(a.UseCount() == 1);
+    REQUIRE(*a == "atomic");
+    REQUIRE(*b == "made");
+}
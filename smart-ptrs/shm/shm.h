@@ -0,0 +1,679 @@
+#pragma once
+
+#include <core/granule_heap.h>
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Smart pointers into a POSIX shared memory segment (shm_open + mmap), for data
+// shared between processes.
+//
+// Every process maps the segment at its own address, so nothing in the segment may
+// hold an absolute address or a vptr: pointers store offsets from the segment base,
+// and counters are address-free atomics inside the objects. The base is a static of
+// ShmSegment<Tag>, one attached segment per Tag and process.
+//
+// A pointer stored inside the segment (a link between objects) counts directly in
+// the object. A pointer in process memory goes through a lease: the process holds a
+// single reference to the object and counts its own copies in a lease table kept in
+// the segment. When a process dies without detaching, RecoverDeadProcesses() in any
+// other process drops the references of its leases. Steps are ordered so that a
+// crash at any point leaks at worst an object, but never frees a live one.
+
+template <typename T, typename Segment>
+class ShmIntrusivePtr;
+template <typename T, typename Segment>
+class ShmSharedPtr;
+
+// Reference counter of an object in a segment: links plus processes holding it.
+class ShmRefCounted {
+public:
+    void IncRef() {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Returns the new value.
+    size_t DecRef() {
+        return count_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_acquire);
+    }
+
+private:
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    std::atomic<uint32_t> count_ = 0;
+};
+
+// Object of ShmSharedPtr together with its counter.
+template <typename T>
+struct ShmBox : ShmRefCounted {
+    template <typename... Args>
+    explicit ShmBox(std::in_place_t, Args&&... args) : value(std::forward<Args>(args)...) {
+    }
+
+    T value;
+};
+
+template <typename Tag>
+class ShmSegment {
+    // Free lists hold offsets in granules.
+    using Heap = core::GranuleHeap<uint64_t, 4>;
+
+public:
+    static constexpr size_t kGranule = Heap::kGranule;
+    static constexpr size_t kMaxProcesses = 32;
+    static constexpr size_t kMaxLeases = 512;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    // Creates the segment `name` of `size` bytes and attaches. An old segment of that
+    // name is unlinked, not truncated: processes that still map it keep valid memory.
+    ShmSegment(const std::string& name, size_t size) {
+        if (size < sizeof(Header) + kGranule) {
+            throw std::invalid_argument("Shared memory segment is too small");
+        }
+        if (shm_unlink(name.c_str()) == -1 && errno != ENOENT) {
+            throw std::system_error(errno, std::generic_category(), "shm_unlink");
+        }
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        }
+        if (ftruncate(fd, size) == -1) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "ftruncate");
+        }
+        Map(fd, size);
+        header_ = new (base_) Header;
+        header_->size = size;
+        header_->heap.used = (sizeof(Header) + kGranule - 1) / kGranule;
+        header_->magic.store(kMagic, std::memory_order_release);
+        Attach();
+    }
+
+    // Attaches to an existing segment.
+    explicit ShmSegment(const std::string& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        }
+        struct stat info;
+        if (fstat(fd, &info) == -1) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat");
+        }
+        Map(fd, info.st_size);
+        header_ = static_cast<Header*>(static_cast<void*>(base_));
+        if (size_ < sizeof(Header) || header_->magic.load(std::memory_order_acquire) != kMagic) {
+            Unmap();
+            throw std::runtime_error("Not an initialized shared memory segment");
+        }
+        Attach();
+    }
+
+    ShmSegment(const ShmSegment& other) = delete;
+    ShmSegment& operator=(const ShmSegment& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    // Every process-held pointer has to be gone.
+    ~ShmSegment() {
+        assert(leases_.empty() && "ShmSegment detached with live pointers");
+        slot_->pid.store(0, std::memory_order_release);
+        Unmap();
+    }
+
+    static void Unlink(const std::string& name) {
+        shm_unlink(name.c_str());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Addressing
+
+    static ShmSegment& Instance() {
+        return *instance_;
+    }
+
+    static bool Contains(const void* ptr) {
+        auto address = static_cast<const char*>(ptr);
+        return address >= base_ && address < base_ + size_;
+    }
+    static uint64_t Encode(const void* ptr) {
+        return ptr ? static_cast<const char*>(ptr) - base_ : 0;
+    }
+    template <typename T>
+    static T* Decode(uint64_t offset) {
+        return reinterpret_cast<T*>(base_ + offset);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Allocation
+
+    // Throws std::bad_alloc when the segment is full.
+    void* Allocate(size_t size) {
+        Guard guard(*this);
+        return header_->heap.Allocate(base_, header_->size / kGranule, size);
+    }
+    void Deallocate(void* block, size_t size) {
+        Guard guard(*this);
+        header_->heap.Deallocate(base_, block, size);
+    }
+
+    // T derives from ShmRefCounted.
+    template <typename T, typename... Args>
+    ShmIntrusivePtr<T, ShmSegment> MakeIntrusive(Args&&... args) {
+        return ShmIntrusivePtr<T, ShmSegment>(Construct<T>(std::forward<Args>(args)...));
+    }
+    template <typename T, typename... Args>
+    ShmSharedPtr<T, ShmSegment> MakeShared(Args&&... args) {
+        return ShmSharedPtr<T, ShmSegment>(
+            Construct<ShmBox<T>>(std::in_place, std::forward<Args>(args)...));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Root
+
+    // The object other processes start from after attaching. All roots of a segment
+    // have one pointer type.
+    template <typename Ptr>
+    Ptr Root() {
+        Guard guard(*this);
+        if (!header_->root) {
+            return Ptr();
+        }
+        return Ptr(Decode<typename Ptr::Object>(header_->root));
+    }
+    template <typename Ptr>
+    void SetRoot(const Ptr& root) {
+        uint64_t old;
+        {
+            Guard guard(*this);
+            if (root) {
+                root.GetObject()->IncRef();
+            }
+            old = std::exchange(header_->root, root.Offset());
+        }
+        if (old) {
+            Ptr::DropRef(old);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Crash recovery
+
+    // Drops the references of processes that died attached. Objects of types this
+    // process never used with a pointer cannot be destroyed here and leak.
+    // Returns the number of recovered processes.
+    size_t RecoverDeadProcesses() {
+        size_t recovered = 0;
+        for (auto& slot : header_->processes) {
+            int32_t pid = slot.pid.load(std::memory_order_acquire);
+            if (pid <= 0 || IsAlive(pid) || !slot.pid.compare_exchange_strong(pid, kRecovering)) {
+                continue;
+            }
+            for (auto& lease : slot.leases) {
+                uint64_t offset = lease.offset.load(std::memory_order_acquire);
+                if (!offset) {
+                    continue;
+                }
+                lease.offset.store(0, std::memory_order_relaxed);
+                lease.count.store(0, std::memory_order_relaxed);
+                auto drop = Types().find(lease.type);
+                if (drop != Types().end()) {
+                    drop->second(offset);
+                }
+            }
+            slot.pid.store(0, std::memory_order_release);
+            ++recovered;
+        }
+        return recovered;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t LiveObjects() {
+        Guard guard(*this);
+        return header_->heap.live;
+    }
+    size_t UsedBytes() {
+        Guard guard(*this);
+        return header_->heap.used * kGranule;
+    }
+    size_t Size() const {
+        return size_;
+    }
+    size_t NumLeases() {
+        std::lock_guard guard(mutex_);
+        return leases_.size();
+    }
+
+private:
+    template <typename Object, typename Segment>
+    friend class ShmPtrBase;
+
+    static constexpr uint64_t kMagic = 0x53484d5345474d31;  // "SHMSEGM1"
+    static constexpr int32_t kRecovering = -1;
+
+    struct Lease {
+        std::atomic<uint64_t> offset = 0;
+        std::atomic<uint64_t> count = 0;
+        uint64_t type = 0;
+    };
+
+    struct ProcessSlot {
+        std::atomic<int32_t> pid = 0;
+        Lease leases[kMaxLeases];
+    };
+
+    struct Header {
+        std::atomic<uint64_t> magic = 0;
+        // Pid of the process in the allocator; stolen if it dies there.
+        std::atomic<int32_t> lock = 0;
+        uint64_t size = 0;
+        uint64_t root = 0;
+        Heap heap;
+        ProcessSlot processes[kMaxProcesses];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<int32_t>::is_always_lock_free);
+
+    // Cross-process allocator lock.
+    class Guard {
+    public:
+        explicit Guard(ShmSegment& segment) : lock_(segment.header_->lock) {
+            int32_t self = getpid();
+            for (size_t spins = 1;; ++spins) {
+                int32_t owner = 0;
+                if (lock_.compare_exchange_weak(owner, self, std::memory_order_acquire)) {
+                    return;
+                }
+                // The allocator only leaks a block if its owner dies halfway.
+                if (owner != 0 && owner != self && spins % 1024 == 0 && !IsAlive(owner) &&
+                    lock_.compare_exchange_strong(owner, self, std::memory_order_acquire)) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        Guard(const Guard& other) = delete;
+        Guard& operator=(const Guard& other) = delete;
+
+        ~Guard() {
+            lock_.store(0, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<int32_t>& lock_;
+    };
+
+    // Whether a process with this pid exists. A pid is reused once its process is gone,
+    // so a dead process whose pid already belongs to another one looks alive: its
+    // leases and a lock it held stay until that other process exits too.
+    static bool IsAlive(int32_t pid) {
+        return kill(pid, 0) == 0 || errno == EPERM;
+    }
+
+    void Map(int fd, size_t size) {
+        void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        close(fd);
+        if (address == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "mmap");
+        }
+        assert(!instance_ && "Only one ShmSegment of a type at a time");
+        base_ = static_cast<char*>(address);
+        size_ = size;
+        instance_ = this;
+    }
+    void Unmap() {
+        munmap(base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+        instance_ = nullptr;
+    }
+
+    void Attach() {
+        for (auto& slot : header_->processes) {
+            int32_t free = 0;
+            if (slot.pid.compare_exchange_strong(free, getpid())) {
+                slot_ = &slot;
+                for (size_t i = kMaxLeases; i > 0; --i) {
+                    free_leases_.push_back(i - 1);
+                }
+                return;
+            }
+        }
+        Unmap();
+        throw std::runtime_error("Too many processes attached to a shared memory segment");
+    }
+
+    template <typename T, typename... Args>
+    T* Construct(Args&&... args) {
+        static_assert(!std::is_polymorphic_v<T>, "A vptr is only valid in one process");
+        static_assert(alignof(T) <= kGranule);
+        void* block = Allocate(sizeof(T));
+        try {
+            return new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(block, sizeof(T));
+            throw;
+        }
+    }
+
+    // Type-erased drop of one reference, by a key stable across processes of a binary:
+    // recovery finds what to destroy for the leases of a dead process.
+    static std::unordered_map<uint64_t, void (*)(uint64_t)>& Types() {
+        static std::unordered_map<uint64_t, void (*)(uint64_t)> types;
+        return types;
+    }
+    template <typename Object>
+    static uint64_t RegisterType(void (*drop)(uint64_t)) {
+        uint64_t key = core::TypeKey<Object>();
+        Types().emplace(key, drop);
+        return key;
+    }
+
+    // Returns the lease index + 1.
+    uint64_t AcquireLease(ShmRefCounted* object, uint64_t type) {
+        uint64_t offset = Encode(object);
+        std::lock_guard guard(mutex_);
+        if (auto it = leases_.find(offset); it != leases_.end()) {
+            slot_->leases[it->second].count.fetch_add(1, std::memory_order_relaxed);
+            return it->second + 1;
+        }
+        if (free_leases_.empty()) {
+            throw std::bad_alloc();
+        }
+        size_t index = free_leases_.back();
+        free_leases_.pop_back();
+        // Count first: a crash before the lease is published only leaks the object.
+        object->IncRef();
+        Lease& lease = slot_->leases[index];
+        lease.type = type;
+        lease.count.store(1, std::memory_order_relaxed);
+        lease.offset.store(offset, std::memory_order_release);
+        leases_.emplace(offset, index);
+        return index + 1;
+    }
+    void AddLease(uint64_t lease) {
+        slot_->leases[lease - 1].count.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Returns true if the process no longer holds the object at `offset`.
+    bool ReleaseLease(uint64_t lease, uint64_t offset) {
+        size_t index = lease - 1;
+        Lease& entry = slot_->leases[index];
+        if (entry.count.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return false;
+        }
+        std::lock_guard guard(mutex_);
+        // Another thread could take the lease again meanwhile.
+        auto it = leases_.find(offset);
+        if (it == leases_.end() || it->second != index ||
+            entry.count.load(std::memory_order_acquire) != 0) {
+            return false;
+        }
+        // Unpublish first: a crash before the object is dropped only leaks it.
+        entry.offset.store(0, std::memory_order_release);
+        leases_.erase(it);
+        free_leases_.push_back(index);
+        return true;
+    }
+
+    static inline char* base_ = nullptr;
+    static inline size_t size_ = 0;
+    static inline ShmSegment* instance_ = nullptr;
+
+    Header* header_ = nullptr;
+    ProcessSlot* slot_ = nullptr;
+    // Process-local index of this process's leases.
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, size_t> leases_;
+    std::vector<size_t> free_leases_;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pointers
+
+// Offset of the object in the low 48 bits, lease index + 1 in the high 16 (0 for links).
+template <typename Object, typename Segment>
+class ShmPtrBase {
+    template <typename Tag>
+    friend class ShmSegment;
+
+public:
+    uint64_t Offset() const {
+        return value_ & kOffsetMask;
+    }
+    size_t UseCount() const {
+        return value_ ? GetObject()->RefCount() : 0;
+    }
+    explicit operator bool() const {
+        return value_ != 0;
+    }
+
+protected:
+    static constexpr int kLeaseShift = 48;
+    static constexpr uint64_t kOffsetMask = (uint64_t{1} << kLeaseShift) - 1;
+
+    ShmPtrBase() {
+    }
+    explicit ShmPtrBase(Object* object) {
+        Attach(object);
+    }
+
+    ShmPtrBase(const ShmPtrBase& other) {
+        CopyFrom(other);
+    }
+    ShmPtrBase(ShmPtrBase&& other) {
+        MoveFrom(other);
+    }
+
+    ShmPtrBase& operator=(const ShmPtrBase& other) {
+        if (this != &other) {
+            uint64_t old = value_;
+            CopyFrom(other);
+            Release(old);
+        }
+        return *this;
+    }
+    ShmPtrBase& operator=(ShmPtrBase&& other) {
+        if (this != &other) {
+            uint64_t old = value_;
+            MoveFrom(other);
+            Release(old);
+        }
+        return *this;
+    }
+
+    ~ShmPtrBase() {
+        Release(value_);
+    }
+
+    void Reset() {
+        Release(std::exchange(value_, 0));
+    }
+    void Swap(ShmPtrBase& other) {
+        // Links and leases stay where they are.
+        ShmPtrBase temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+    Object* GetObject() const {
+        return Segment::template Decode<Object>(value_ & kOffsetMask);
+    }
+
+private:
+    static void DropRef(uint64_t offset) {
+        auto object = Segment::template Decode<Object>(offset);
+        if (object->DecRef() == 0) {
+            object->~Object();
+            Segment::Instance().Deallocate(object, sizeof(Object));
+        }
+    }
+
+    static void Release(uint64_t value) {
+        if (!value) {
+            return;
+        }
+        uint64_t offset = value & kOffsetMask;
+        uint64_t lease = value >> kLeaseShift;
+        if (!lease || Segment::Instance().ReleaseLease(lease, offset)) {
+            DropRef(offset);
+        }
+    }
+
+    // Only for an empty pointer.
+    void Attach(Object* object) {
+        if (!object) {
+            return;
+        }
+        if (Segment::Contains(this)) {
+            object->IncRef();
+            value_ = Segment::Encode(object);
+        } else {
+            uint64_t lease = Segment::Instance().AcquireLease(object, kTypeKey);
+            value_ = Segment::Encode(object) | (lease << kLeaseShift);
+        }
+    }
+
+    void CopyFrom(const ShmPtrBase& other) {
+        value_ = 0;
+        if (!other.value_) {
+            return;
+        }
+        uint64_t lease = other.value_ >> kLeaseShift;
+        if (!Segment::Contains(this) && lease) {
+            Segment::Instance().AddLease(lease);
+            value_ = other.value_;
+        } else {
+            Attach(other.GetObject());
+        }
+    }
+    void MoveFrom(ShmPtrBase& other) {
+        bool leased = other.value_ >> kLeaseShift;
+        if (!other.value_ || leased != Segment::Contains(this)) {
+            value_ = std::exchange(other.value_, 0);
+        } else {
+            CopyFrom(other);
+            other.Reset();
+        }
+    }
+
+    static inline const uint64_t kTypeKey = Segment::template RegisterType<Object>(&DropRef);
+
+    uint64_t value_ = 0;
+};
+
+// T derives from ShmRefCounted.
+template <typename T, typename Segment>
+class ShmIntrusivePtr : public ShmPtrBase<T, Segment> {
+    friend Segment;
+    using Base = ShmPtrBase<T, Segment>;
+
+public:
+    using Object = T;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ShmIntrusivePtr() {
+    }
+    ShmIntrusivePtr(std::nullptr_t) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    using Base::Reset;
+    void Swap(ShmIntrusivePtr& other) {
+        Base::Swap(other);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return *this ? this->GetObject() : nullptr;
+    }
+    T& operator*() const {
+        return *this->GetObject();
+    }
+    T* operator->() const {
+        return this->GetObject();
+    }
+
+private:
+    explicit ShmIntrusivePtr(T* object) : Base(object) {
+    }
+};
+
+// For any T without a vptr or absolute addresses; the counter is placed before T.
+template <typename T, typename Segment>
+class ShmSharedPtr : public ShmPtrBase<ShmBox<T>, Segment> {
+    friend Segment;
+    using Base = ShmPtrBase<ShmBox<T>, Segment>;
+
+public:
+    using Object = ShmBox<T>;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ShmSharedPtr() {
+    }
+    ShmSharedPtr(std::nullptr_t) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    using Base::Reset;
+    void Swap(ShmSharedPtr& other) {
+        Base::Swap(other);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return *this ? &this->GetObject()->value : nullptr;
+    }
+    T& operator*() const {
+        return this->GetObject()->value;
+    }
+    T* operator->() const {
+        return &this->GetObject()->value;
+    }
+
+private:
+    explicit ShmSharedPtr(ShmBox<T>* object) : Base(object) {
+    }
+};
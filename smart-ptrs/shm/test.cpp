@@ -0,0 +1,200 @@
+#include "shm.h"
+
+#include <catch.hpp>
+
+#include <array>
+#include <cstdlib>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tag;
+using Segment = ShmSegment<Tag>;
+
+struct Node : ShmRefCounted {
+    explicit Node(int value) : value(value) {
+    }
+
+    int value;
+    ShmIntrusivePtr<Node, Segment> next;
+};
+
+using NodePtr = ShmIntrusivePtr<Node, Segment>;
+
+struct Point {
+    int x;
+    int y;
+};
+
+constexpr size_t kSize = 1 << 22;
+
+std::string SegmentName() {
+    return "/smart_ptrs_test_" + std::to_string(getpid());
+}
+
+// Runs the "Shm worker" test case below in a fresh process (own address space and
+// own mapping of the segment). Returns the exit status.
+int RunWorker(const std::string& name, const std::string& mode) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv("SHM_NAME", name.c_str(), 1);
+        setenv("SHM_MODE", mode.c_str(), 1);
+        execl("/proc/self/exe", "/proc/self/exe", "Shm worker", "-o", "/dev/null",
+              static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+int Sum(const NodePtr& head) {
+    int sum = 0;
+    for (Node* node = head.Get(); node; node = node->next.Get()) {
+        sum += node->value;
+    }
+    return sum;
+}
+
+NodePtr MakeList(Segment& segment, int length) {
+    NodePtr head;
+    for (int i = length; i > 0; --i) {
+        auto node = segment.MakeIntrusive<Node>(i);
+        node->next = head;
+        head = node;
+    }
+    return head;
+}
+
+}  // namespace
+
+TEST_CASE("Shm worker", "[.]") {
+    const char* name = std::getenv("SHM_NAME");
+    const char* mode = std::getenv("SHM_MODE");
+    if (!name || !mode) {
+        return;
+    }
+    Segment segment(name);
+    auto root = segment.Root<NodePtr>();
+    REQUIRE(Sum(root) == 6);
+    if (std::string(mode) == "drop") {
+        segment.SetRoot(NodePtr());
+        root.Reset();
+    } else if (std::string(mode) == "crash") {
+        auto copy = root;
+        auto own = segment.MakeIntrusive<Node>(42);
+        kill(getpid(), SIGKILL);
+    }
+}
+
+TEST_CASE("Links and leases") {
+    auto name = SegmentName();
+    Segment segment(name, kSize);
+    Segment::Unlink(name);
+
+    auto head = segment.MakeIntrusive<Node>(1);
+    REQUIRE(head.UseCount() == 1);
+    REQUIRE(segment.NumLeases() == 1);
+
+    head->next = segment.MakeIntrusive<Node>(2);
+    REQUIRE(head->next.UseCount() == 1);
+    REQUIRE(segment.NumLeases() == 1);
+
+    // Copies in one process share its lease.
+    auto copy = head;
+    auto second = head->next;
+    REQUIRE(head.UseCount() == 1);
+    REQUIRE(second.UseCount() == 2);
+    REQUIRE(segment.NumLeases() == 2);
+
+    head.Reset();
+    second.Reset();
+    REQUIRE(segment.LiveObjects() == 2);
+    copy.Reset();
+    REQUIRE(segment.LiveObjects() == 0);
+    REQUIRE(segment.NumLeases() == 0);
+}
+
+TEST_CASE("Freed blocks are reused") {
+    auto name = SegmentName();
+    Segment segment(name, kSize);
+    Segment::Unlink(name);
+
+    auto first = segment.MakeShared<Point>(Point{1, 2});
+    REQUIRE(first->y == 2);
+    uint64_t offset = first.Offset();
+    first.Reset();
+    size_t used = segment.UsedBytes();
+
+    auto second = segment.MakeShared<Point>(Point{3, 4});
+    REQUIRE(second.Offset() == offset);
+    REQUIRE(segment.UsedBytes() == used);
+
+    // Large blocks go to power-of-two classes.
+    using Big = std::array<char, 5000>;
+    auto big = segment.MakeShared<Big>();
+    offset = big.Offset();
+    big.Reset();
+    big = segment.MakeShared<Big>();
+    REQUIRE(big.Offset() == offset);
+}
+
+TEST_CASE("Another process reads and frees") {
+    auto name = SegmentName();
+    Segment segment(name, kSize);
+    segment.SetRoot(MakeList(segment, 3));
+    REQUIRE(segment.LiveObjects() == 3);
+
+    REQUIRE(RunWorker(name, "read") == 0);
+    REQUIRE(segment.LiveObjects() == 3);
+    REQUIRE(segment.RecoverDeadProcesses() == 0);
+
+    // The last reference drops in the worker, and the worker frees the list.
+    REQUIRE(RunWorker(name, "drop") == 0);
+    REQUIRE(segment.LiveObjects() == 0);
+    REQUIRE(!segment.Root<NodePtr>());
+    Segment::Unlink(name);
+}
+
+TEST_CASE("Crash recovery") {
+    auto name = SegmentName();
+    Segment segment(name, kSize);
+    auto list = MakeList(segment, 3);
+    segment.SetRoot(list);
+
+    int status = RunWorker(name, "crash");
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGKILL);
+    REQUIRE(list.UseCount() == 3);
+    REQUIRE(segment.LiveObjects() == 4);
+
+    REQUIRE(segment.RecoverDeadProcesses() == 1);
+    REQUIRE(list.UseCount() == 2);
+    REQUIRE(segment.LiveObjects() == 3);
+    REQUIRE(segment.RecoverDeadProcesses() == 0);
+
+    segment.SetRoot(NodePtr());
+    list.Reset();
+    REQUIRE(segment.LiveObjects() == 0);
+    Segment::Unlink(name);
+}
+
+TEST_CASE("Recreating a segment keeps old mappings") {
+    struct OtherTag;
+    auto name = SegmentName();
+    Segment old_segment(name, kSize);
+    auto point = old_segment.MakeShared<Point>(Point{5, 6});
+
+    // Truncating the old file would make every access to `point` a SIGBUS.
+    ShmSegment<OtherTag> new_segment(name, kSize);
+    REQUIRE(point->y == 6);
+    REQUIRE(old_segment.LiveObjects() == 1);
+    REQUIRE(new_segment.LiveObjects() == 0);
+    point.Reset();
+    Segment::Unlink(name);
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+
+// Slab allocator for small fixed-size blocks such as control blocks.
+//
+// Sizes are rounded up to a multiple of kClassStep; every size class has its own
+// page-sized slabs split into equal slots. The slab header sits at the start of the
+// page, so the slab of a block is found by masking its address. A fresh slab hands
+// out slots by bumping an index; freed slots are marked in the slab's bitmap and
+// reused (lowest first) once the bump index reaches the end. A slab that becomes
+// empty goes back to the OS (munmap), except for one spare slab per class that
+// absorbs alloc/free ping-pong at the boundary.
+//
+// Slabs of one class share a lock, but a thread takes it only once per kBatch blocks:
+// every thread keeps a magazine (a stack of free blocks) per class. Allocate pops
+// from the magazine and refills it with kBatch blocks when it is empty; Deallocate
+// pushes onto the magazine of the freeing thread and returns its oldest kBatch blocks
+// when it is full. A thread returns its magazines when it exits, so a slab only goes
+// back to the OS once no magazine holds its blocks (see FlushThreadCache).
+//
+// Blocks larger than kMaxBlockSize go to ::operator new.
+class SlabAllocator {
+public:
+    static constexpr size_t kSlabSize = 4096;
+    static constexpr size_t kClassStep = 16;
+    static constexpr size_t kMaxBlockSize = 256;
+    static constexpr size_t kMagazineSize = 32;
+    static constexpr size_t kBatch = kMagazineSize / 2;
+
+    static SlabAllocator& Instance() {
+        // Never destroyed: blocks may be freed during static destruction.
+        static SlabAllocator* allocator = new SlabAllocator;
+        return *allocator;
+    }
+
+    SlabAllocator(const SlabAllocator& other) = delete;
+    SlabAllocator& operator=(const SlabAllocator& other) = delete;
+
+    void* Allocate(size_t size) {
+        if (size > kMaxBlockSize) {
+            return ::operator new(size);
+        }
+        size_t class_index = ClassIndex(size);
+        if (cache_destroyed_) {
+            SizeClass& size_class = classes_[class_index];
+            std::lock_guard guard(size_class.mutex);
+            return AllocateLocked(size_class, class_index);
+        }
+        Magazine& magazine = LocalCache().magazines[class_index];
+        if (magazine.count == 0) {
+            Refill(magazine, class_index);
+        }
+        return magazine.blocks[--magazine.count];
+    }
+
+    void Deallocate(void* block, size_t size) {
+        if (size > kMaxBlockSize) {
+            ::operator delete(block);
+            return;
+        }
+        size_t class_index = ClassIndex(size);
+        assert(SlabOf(block)->class_index == class_index);
+        if (cache_destroyed_) {
+            Return(class_index, &block, 1);
+            return;
+        }
+        Magazine& magazine = LocalCache().magazines[class_index];
+        if (magazine.count == kMagazineSize) {
+            Return(class_index, magazine.blocks, kBatch);
+            std::copy(magazine.blocks + kBatch, magazine.blocks + kMagazineSize, magazine.blocks);
+            magazine.count -= kBatch;
+        }
+        magazine.blocks[magazine.count++] = block;
+    }
+
+    // Returns the free blocks cached by the calling thread to their slabs.
+    void FlushThreadCache() {
+        if (!cache_destroyed_) {
+            Flush(LocalCache());
+        }
+    }
+
+    // Slabs currently mapped, spares included.
+    size_t NumSlabs() const {
+        return num_slabs_.load(std::memory_order_relaxed);
+    }
+    static size_t SlotsPerSlab(size_t size) {
+        return (kSlabSize - kFirstSlot) / ((size + kClassStep - 1) / kClassStep * kClassStep);
+    }
+
+private:
+    static constexpr size_t kNumClasses = kMaxBlockSize / kClassStep;
+
+    struct Slab {
+        Slab* prev;
+        Slab* next;
+        uint32_t class_index;
+        uint32_t slot_size;
+        uint32_t num_slots;
+        uint32_t bump;
+        uint32_t used;
+        // Bit i is set if slot i (below `bump`) is free.
+        uint64_t free_bits[(kSlabSize / kClassStep + 63) / 64];
+    };
+
+    static constexpr size_t kFirstSlot = (sizeof(Slab) + kClassStep - 1) / kClassStep * kClassStep;
+
+    struct SizeClass {
+        std::mutex mutex;
+        // Slabs with free slots; full slabs are not linked anywhere.
+        Slab* partial = nullptr;
+        Slab* spare = nullptr;
+    };
+
+    struct Magazine {
+        void* blocks[kMagazineSize];
+        size_t count = 0;
+    };
+
+    struct Cache {
+        ~Cache() {
+            Instance().Flush(*this);
+            cache_destroyed_ = true;
+        }
+
+        Magazine magazines[kNumClasses];
+    };
+
+    SlabAllocator() {
+    }
+
+    static size_t ClassIndex(size_t size) {
+        return size ? (size - 1) / kClassStep : 0;
+    }
+
+    static Slab* SlabOf(void* block) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(block) & ~(kSlabSize - 1));
+    }
+
+    // Trivially destructible, so it outlives the cache until the thread is gone.
+    static inline thread_local bool cache_destroyed_ = false;
+
+    static Cache& LocalCache() {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    // Takes up to kBatch blocks under one lock; throws only if it got none.
+    void Refill(Magazine& magazine, size_t class_index) {
+        SizeClass& size_class = classes_[class_index];
+        void* fresh[kBatch];
+        size_t count = 0;
+        try {
+            std::lock_guard guard(size_class.mutex);
+            for (; count < kBatch; ++count) {
+                fresh[count] = AllocateLocked(size_class, class_index);
+            }
+        } catch (const std::bad_alloc&) {
+            if (count == 0) {
+                throw;
+            }
+        }
+        // The lowest address is popped first.
+        while (count > 0) {
+            magazine.blocks[magazine.count++] = fresh[--count];
+        }
+    }
+
+    void Flush(Cache& cache) {
+        for (size_t class_index = 0; class_index < kNumClasses; ++class_index) {
+            Magazine& magazine = cache.magazines[class_index];
+            Return(class_index, magazine.blocks, magazine.count);
+            magazine.count = 0;
+        }
+    }
+
+    // Gives `count` blocks back to their slabs under one lock.
+    void Return(size_t class_index, void* const* blocks, size_t count) {
+        SizeClass& size_class = classes_[class_index];
+        Slab* release[kMagazineSize];
+        size_t num_release = 0;
+        {
+            std::lock_guard guard(size_class.mutex);
+            for (size_t i = 0; i < count; ++i) {
+                if (Slab* slab = FreeLocked(size_class, blocks[i])) {
+                    release[num_release++] = slab;
+                }
+            }
+        }
+        for (size_t i = 0; i < num_release; ++i) {
+            munmap(release[i], kSlabSize);
+            num_slabs_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void* AllocateLocked(SizeClass& size_class, size_t class_index) {
+        Slab* slab = size_class.partial;
+        if (!slab) {
+            slab = std::exchange(size_class.spare, nullptr);
+            if (!slab) {
+                slab = NewSlab(class_index);
+            }
+            Push(size_class.partial, slab);
+        }
+
+        uint32_t index;
+        if (slab->bump < slab->num_slots) {
+            index = slab->bump++;
+        } else {
+            size_t word = 0;
+            while (!slab->free_bits[word]) {
+                ++word;
+            }
+            index = word * 64 + std::countr_zero(slab->free_bits[word]);
+            slab->free_bits[word] &= slab->free_bits[word] - 1;
+        }
+        if (++slab->used == slab->num_slots) {
+            Unlink(size_class.partial, slab);
+        }
+        return reinterpret_cast<char*>(slab) + kFirstSlot + index * slab->slot_size;
+    }
+
+    // Returns a slab to unmap, if any.
+    Slab* FreeLocked(SizeClass& size_class, void* block) {
+        Slab* slab = SlabOf(block);
+        size_t index = (static_cast<char*>(block) - reinterpret_cast<char*>(slab) - kFirstSlot) /
+                       slab->slot_size;
+        assert(!(slab->free_bits[index / 64] & (uint64_t{1} << (index % 64))));
+        if (slab->used-- == slab->num_slots) {
+            Push(size_class.partial, slab);
+        }
+        if (slab->used == 0) {
+            Unlink(size_class.partial, slab);
+            return std::exchange(size_class.spare, Reset(slab));
+        }
+        slab->free_bits[index / 64] |= uint64_t{1} << (index % 64);
+        return nullptr;
+    }
+
+    Slab* NewSlab(size_t class_index) {
+        void* page = mmap(nullptr, kSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1, 0);
+        if (page == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        num_slabs_.fetch_add(1, std::memory_order_relaxed);
+        auto slab = static_cast<Slab*>(page);
+        slab->class_index = class_index;
+        slab->slot_size = (class_index + 1) * kClassStep;
+        slab->num_slots = (kSlabSize - kFirstSlot) / slab->slot_size;
+        return Reset(slab);
+    }
+
+    // Back to bump allocation.
+    static Slab* Reset(Slab* slab) {
+        slab->prev = slab->next = nullptr;
+        slab->bump = 0;
+        slab->used = 0;
+        for (auto& word : slab->free_bits) {
+            word = 0;
+        }
+        return slab;
+    }
+
+    static void Push(Slab*& head, Slab* slab) {
+        slab->prev = nullptr;
+        slab->next = head;
+        if (head) {
+            head->prev = slab;
+        }
+        head = slab;
+    }
+    static void Unlink(Slab*& head, Slab* slab) {
+        if (slab->prev) {
+            slab->prev->next = slab->next;
+        } else {
+            head = slab->next;
+        }
+        if (slab->next) {
+            slab->next->prev = slab->prev;
+        }
+        slab->prev = slab->next = nullptr;
+    }
+
+    SizeClass classes_[kNumClasses];
+    std::atomic<size_t> num_slabs_ = 0;
+};
+
+// Block allocator policy of the SharedPtr core (see core/shared.h).
+struct SlabBlockAllocator {
+    static void* Allocate(size_t size) {
+        return SlabAllocator::Instance().Allocate(size);
+    }
+    static void Deallocate(void* block, size_t size) {
+        SlabAllocator::Instance().Deallocate(block, size);
+    }
+};
+
+// Allocation of a class from SlabAllocator: `struct Block : SlabAllocated { ... };`
+struct SlabAllocated {
+    static void* operator new(size_t size) {
+        return SlabAllocator::Instance().Allocate(size);
+    }
+    static void operator delete(void* block, size_t size) {
+        SlabAllocator::Instance().Deallocate(block, size);
+    }
+};
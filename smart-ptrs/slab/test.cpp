@@ -0,0 +1,188 @@
+#include "slab.h"
+
+#include <weak/weak.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Block : SlabAllocated {
+    uint64_t payload[5] = {};
+};
+
+uintptr_t Page(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) / SlabAllocator::kSlabSize;
+}
+
+}  // namespace
+
+TEST_CASE("Blocks are dense") {
+    SlabAllocator::Instance().FlushThreadCache();
+    size_t per_slab = SlabAllocator::SlotsPerSlab(sizeof(Block));
+    REQUIRE(per_slab >= 70);
+
+    std::vector<Block*> blocks;
+    for (size_t i = 0; i < per_slab; ++i) {
+        blocks.push_back(new Block);
+    }
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        REQUIRE(Page(blocks[i]) == Page(blocks[0]));
+        REQUIRE(reinterpret_cast<char*>(blocks[i]) - reinterpret_cast<char*>(blocks[i - 1]) == 48);
+    }
+    for (auto block : blocks) {
+        delete block;
+    }
+}
+
+TEST_CASE("Freed slots are reused") {
+    size_t per_slab = SlabAllocator::SlotsPerSlab(sizeof(Block));
+    std::vector<Block*> blocks;
+    for (size_t i = 0; i < per_slab; ++i) {
+        blocks.push_back(new Block);
+    }
+    Block* middle = blocks[per_slab / 2];
+    delete middle;
+    blocks[per_slab / 2] = new Block;
+    REQUIRE(blocks[per_slab / 2] == middle);
+    for (auto block : blocks) {
+        delete block;
+    }
+}
+
+TEST_CASE("Empty slabs go back to the OS") {
+    auto& allocator = SlabAllocator::Instance();
+    size_t per_slab = SlabAllocator::SlotsPerSlab(sizeof(Block));
+    size_t before = allocator.NumSlabs();
+
+    std::vector<Block*> blocks;
+    for (size_t i = 0; i < 10 * per_slab; ++i) {
+        blocks.push_back(new Block);
+    }
+    REQUIRE(allocator.NumSlabs() >= before + 9);
+    std::shuffle(blocks.begin(), blocks.end(), std::mt19937(42));
+    for (auto block : blocks) {
+        delete block;
+    }
+    // The freeing thread caches a magazine of blocks until it flushes or exits.
+    allocator.FlushThreadCache();
+    // One spare slab per class stays.
+    REQUIRE(allocator.NumSlabs() <= before + 1);
+}
+
+TEST_CASE("Large blocks") {
+    struct Large : SlabAllocated {
+        char data[SlabAllocator::kMaxBlockSize + 1];
+    };
+    auto& allocator = SlabAllocator::Instance();
+    size_t before = allocator.NumSlabs();
+    auto large = new Large;
+    REQUIRE(allocator.NumSlabs() == before);
+    delete large;
+}
+
+TEST_CASE("Control blocks of SharedPtr") {
+    auto& allocator = SlabAllocator::Instance();
+    size_t before = allocator.NumSlabs();
+    std::vector<SharedPtr<int>> ptrs;
+    for (int i = 0; i < 1000; ++i) {
+        ptrs.emplace_back(new int(i));
+    }
+    REQUIRE(allocator.NumSlabs() > before);
+    WeakPtr<int> weak(ptrs[10]);
+    ptrs.clear();
+    REQUIRE(weak.Expired());
+    weak.Reset();
+    allocator.FlushThreadCache();
+    REQUIRE(allocator.NumSlabs() <= before + 1);
+}
+
+TEST_CASE("Slab stress") {
+    constexpr int kThreads = 4;
+    constexpr int kIterations = 20000;
+    std::atomic<bool> ok = true;
+    std::vector<std::thread> threads;
+    // Blocks are freed by other threads than the ones that allocated them.
+    std::vector<std::vector<Block*>> handoff(kThreads);
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&, i] {
+            std::mt19937 gen(i);
+            std::vector<Block*> own;
+            for (int j = 0; j < kIterations; ++j) {
+                if (own.empty() || gen() % 3) {
+                    auto block = new Block;
+                    block->payload[0] = i;
+                    own.push_back(block);
+                } else {
+                    std::swap(own[gen() % own.size()], own.back());
+                    if (own.back()->payload[0] != static_cast<uint64_t>(i)) {
+                        ok = false;
+                    }
+                    delete own.back();
+                    own.pop_back();
+                }
+            }
+            handoff[i] = std::move(own);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&, i] {
+            for (auto block : handoff[(i + 1) % kThreads]) {
+                delete block;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(ok);
+}
+
+TEST_CASE("Exited threads return their magazines") {
+    auto& allocator = SlabAllocator::Instance();
+    allocator.FlushThreadCache();
+    size_t before = allocator.NumSlabs();
+    std::thread thread([] {
+        std::vector<Block*> blocks;
+        for (size_t i = 0; i < 3 * SlabAllocator::SlotsPerSlab(sizeof(Block)); ++i) {
+            blocks.push_back(new Block);
+        }
+        for (auto block : blocks) {
+            delete block;
+        }
+    });
+    thread.join();
+    REQUIRE(allocator.NumSlabs() <= before + 1);
+}
+
+TEST_CASE("Magazines hand out consecutive slots") {
+    auto& allocator = SlabAllocator::Instance();
+    allocator.FlushThreadCache();
+    // Blocks of one refill come from consecutive slots.
+    std::vector<Block*> blocks;
+    for (size_t i = 0; i < SlabAllocator::kBatch; ++i) {
+        blocks.push_back(new Block);
+    }
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        REQUIRE(blocks[i] > blocks[i - 1]);
+    }
+    // Freed blocks stay in the magazine and come back first.
+    Block* last = blocks.back();
+    delete last;
+    blocks.back() = new Block;
+    REQUIRE(blocks.back() == last);
+    for (auto block : blocks) {
+        delete block;
+    }
+}
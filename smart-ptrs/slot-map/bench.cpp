@@ -0,0 +1,91 @@
+#include "slot_map.h"
+
+#include <weak/weak.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Hundreds of thousands of entities referenced in random order: SlotMap handles against
+// WeakPtr-s to MakeShared objects. Run with `test_slot_map [.bench]`.
+
+namespace {
+
+struct Entity {
+    float x = 0;
+    float y = 0;
+    int hp = 100;
+};
+
+constexpr int kEntities = 1 << 18;
+constexpr int kRounds = 8;
+
+template <typename Fn>
+double MeasureNs(Fn fn) {
+    int64_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round) {
+        sum += fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    volatile int64_t sink = sum;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kRounds / kEntities;
+}
+
+}  // namespace
+
+TEST_CASE("SlotMap vs WeakPtr", "[.bench]") {
+    std::mt19937 rng(1);
+
+    SlotMap<Entity> map;
+    std::vector<SlotHandle> handles;
+    std::vector<SharedPtr<Entity>> owners;
+    std::vector<WeakPtr<Entity>> weaks;
+    for (int i = 0; i < kEntities; ++i) {
+        handles.push_back(map.Emplace());
+        owners.push_back(MakeShared<Entity>());
+    }
+    // Scatter the heap objects as a long-running program would.
+    std::shuffle(owners.begin(), owners.end(), rng);
+    for (const auto& owner : owners) {
+        weaks.emplace_back(owner);
+    }
+    std::shuffle(handles.begin(), handles.end(), rng);
+
+    double get_ns = MeasureNs([&] {
+        int64_t sum = 0;
+        for (auto handle : handles) {
+            if (auto entity = map.Get(handle)) {
+                sum += entity->hp;
+            }
+        }
+        return sum;
+    });
+    double weak_ns = MeasureNs([&] {
+        int64_t sum = 0;
+        for (const auto& weak : weaks) {
+            if (auto entity = weak.Lock()) {
+                sum += entity->hp;
+            }
+        }
+        return sum;
+    });
+    double scan_ns = MeasureNs([&] {
+        int64_t sum = 0;
+        for (const auto& entity : map) {
+            sum += entity.hp;
+        }
+        return sum;
+    });
+
+    std::cout << "SlotMap::Get:\t" << get_ns << " ns/entity\n"
+              << "WeakPtr::Lock:\t" << weak_ns << " ns/entity\n"
+              << "SlotMap scan:\t" << scan_ns << " ns/entity\n"
+              << "Handle: " << sizeof(SlotHandle) << " bytes, WeakPtr: " << sizeof(WeakPtr<Entity>)
+              << " bytes\n";
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// 64-bit handle of a SlotMap element: slot index and generation of the slot.
+class SlotHandle {
+    template <typename T>
+    friend class SlotMap;
+
+public:
+    SlotHandle() {
+    }
+
+    uint32_t Index() const {
+        return index_;
+    }
+    uint32_t Generation() const {
+        return generation_;
+    }
+
+    uint64_t ToBits() const {
+        return uint64_t{generation_} << 32 | index_;
+    }
+    static SlotHandle FromBits(uint64_t bits) {
+        return SlotHandle(static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32));
+    }
+
+    bool operator==(const SlotHandle& other) const = default;
+
+    // A default handle never refers to an element.
+    explicit operator bool() const {
+        return generation_ != 0;
+    }
+
+private:
+    SlotHandle(uint32_t index, uint32_t generation) : index_(index), generation_(generation) {
+    }
+
+    uint32_t index_ = 0;
+    uint32_t generation_ = 0;
+};
+
+// Dense storage of objects addressed by generational handles: a cache-friendly
+// replacement for many WeakPtr-s to small objects.
+//
+//     SlotMap<Entity> entities;
+//     SlotHandle handle = entities.Emplace(...);
+//     if (Entity* entity = entities.Get(handle)) { ... }
+//
+// The objects lie contiguously in one vector, so iterating over all of them is a linear
+// scan. A handle names a slot; the slot holds the position of its object and a
+// generation that changes whenever the slot is emptied. Validating a handle compares
+// generations: one 8-byte slot, one cache line. An odd generation marks an occupied
+// slot, so a default handle (generation 0) is never valid. Erase moves the last object
+// into the hole, and emptied slots are reused through a free list.
+//
+// Get() returns a borrowed pointer, valid until the next Emplace or Erase: both move
+// objects. There is no SharedPtr promotion, since no pointer into the dense storage can
+// keep its element in place. The map is not thread-safe.
+template <typename T>
+class SlotMap {
+    struct Slot {
+        uint32_t generation = 0;
+        // Position in `values_` if occupied, next free slot otherwise.
+        uint32_t position = 0;
+    };
+
+public:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SlotMap() {
+    }
+
+    SlotMap(const SlotMap& other) = delete;
+    SlotMap& operator=(const SlotMap& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    template <typename... Args>
+    SlotHandle Emplace(Args&&... args) {
+        // Everything that may throw goes first: a failed Emplace leaves at most a new free slot.
+        if (free_head_ == kNoSlot) {
+            free_head_ = slots_.size();
+            slots_.push_back(Slot{0, kNoSlot});
+        }
+        uint32_t index = free_head_;
+        value_slots_.push_back(index);
+        try {
+            values_.emplace_back(std::forward<Args>(args)...);
+        } catch (...) {
+            value_slots_.pop_back();
+            throw;
+        }
+
+        Slot& slot = slots_[index];
+        free_head_ = slot.position;
+        ++slot.generation;
+        slot.position = values_.size() - 1;
+        return SlotHandle(index, slot.generation);
+    }
+
+    SlotHandle Insert(T value) {
+        return Emplace(std::move(value));
+    }
+
+    // Returns false for a stale handle.
+    bool Erase(SlotHandle handle) {
+        if (!Contains(handle)) {
+            return false;
+        }
+        Slot& slot = slots_[handle.index_];
+        uint32_t last = values_.size() - 1;
+        if (slot.position != last) {
+            values_[slot.position] = std::move(values_[last]);
+            value_slots_[slot.position] = value_slots_[last];
+            slots_[value_slots_[last]].position = slot.position;
+        }
+        values_.pop_back();
+        value_slots_.pop_back();
+
+        ++slot.generation;
+        slot.position = free_head_;
+        free_head_ = handle.index_;
+        return true;
+    }
+
+    // Invalidates every handle.
+    void Clear() {
+        for (uint32_t index : value_slots_) {
+            Slot& slot = slots_[index];
+            ++slot.generation;
+            slot.position = free_head_;
+            free_head_ = index;
+        }
+        values_.clear();
+        value_slots_.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Lookup
+
+    bool Contains(SlotHandle handle) const {
+        // A free slot has an even generation, which no handle of an element carries.
+        return (handle.generation_ & 1) != 0 && handle.index_ < slots_.size() &&
+               slots_[handle.index_].generation == handle.generation_;
+    }
+
+    // nullptr for a stale handle.
+    T* Get(SlotHandle handle) {
+        if (!Contains(handle)) {
+            return nullptr;
+        }
+        return &values_[slots_[handle.index_].position];
+    }
+    const T* Get(SlotHandle handle) const {
+        return const_cast<SlotMap*>(this)->Get(handle);
+    }
+
+    // Handle of the object at `position` of the dense storage.
+    SlotHandle HandleAt(size_t position) const {
+        uint32_t index = value_slots_[position];
+        return SlotHandle(index, slots_[index].generation);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Iteration over the dense storage, in no particular order.
+
+    T* begin() {
+        return values_.data();
+    }
+    T* end() {
+        return values_.data() + values_.size();
+    }
+    const T* begin() const {
+        return values_.data();
+    }
+    const T* end() const {
+        return values_.data() + values_.size();
+    }
+
+    size_t Size() const {
+        return values_.size();
+    }
+    bool Empty() const {
+        return values_.empty();
+    }
+
+private:
+    std::vector<T> values_;
+    // Slot of every value.
+    std::vector<uint32_t> value_slots_;
+    std::vector<Slot> slots_;
+    uint32_t free_head_ = kNoSlot;
+};
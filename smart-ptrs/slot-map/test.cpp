@@ -0,0 +1,141 @@
+#include "slot_map.h"
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("SlotMap basics") {
+    SlotMap<std::string> map;
+    REQUIRE(map.Empty());
+    REQUIRE(!map.Contains(SlotHandle()));
+    REQUIRE(!SlotHandle());
+
+    auto a = map.Emplace(3, 'a');
+    auto b = map.Insert("b");
+    REQUIRE(a);
+    REQUIRE(a != b);
+    REQUIRE(map.Size() == 2);
+    REQUIRE(*map.Get(a) == "aaa");
+    REQUIRE(*map.Get(b) == "b");
+    REQUIRE(SlotHandle::FromBits(a.ToBits()) == a);
+
+    REQUIRE(map.Erase(a));
+    REQUIRE(!map.Erase(a));
+    REQUIRE(!map.Contains(a));
+    REQUIRE(map.Get(a) == nullptr);
+    REQUIRE(*map.Get(b) == "b");
+
+    // The slot is reused with a new generation.
+    auto c = map.Insert("c");
+    REQUIRE(c.Index() == a.Index());
+    REQUIRE(c.Generation() != a.Generation());
+    REQUIRE(!map.Contains(a));
+    REQUIRE(*map.Get(c) == "c");
+}
+
+TEST_CASE("SlotMap constructor throws") {
+    struct Throwing {
+        explicit Throwing(bool fail) : value(1) {
+            if (fail) {
+                throw std::runtime_error("fail");
+            }
+        }
+
+        int value;
+    };
+
+    SlotMap<Throwing> map;
+    REQUIRE_THROWS_AS(map.Emplace(true), std::runtime_error);
+    REQUIRE(map.Empty());
+    // The free slot left behind is not reachable through a default handle.
+    REQUIRE(!map.Contains(SlotHandle()));
+    REQUIRE(map.Get(SlotHandle()) == nullptr);
+    REQUIRE(!map.Erase(SlotHandle()));
+
+    auto handle = map.Emplace(false);
+    REQUIRE(map.Size() == 1);
+    REQUIRE(map.Get(handle)->value == 1);
+    REQUIRE(map.HandleAt(0) == handle);
+}
+
+TEST_CASE("SlotMap iteration is dense") {
+    SlotMap<int> map;
+    std::vector<SlotHandle> handles;
+    for (int i = 0; i < 10; ++i) {
+        handles.push_back(map.Insert(i));
+    }
+    for (int i = 0; i < 10; i += 2) {
+        map.Erase(handles[i]);
+    }
+    REQUIRE(map.Size() == 5);
+    REQUIRE(map.end() - map.begin() == 5);
+
+    std::vector<int> values(map.begin(), map.end());
+    std::sort(values.begin(), values.end());
+    REQUIRE(values == std::vector<int>{1, 3, 5, 7, 9});
+
+    for (size_t i = 0; i < map.Size(); ++i) {
+        REQUIRE(map.Get(map.HandleAt(i)) == map.begin() + i);
+    }
+
+    map.Clear();
+    REQUIRE(map.Empty());
+    for (auto handle : handles) {
+        REQUIRE(!map.Contains(handle));
+    }
+}
+
+TEST_CASE("SlotMap handles survive moves") {
+    SlotMap<std::string> map;
+    auto first = map.Insert("first");
+    auto second = map.Insert("second");
+    const std::string* borrowed = map.Get(first);
+    REQUIRE(*borrowed == "first");
+
+    // Reallocates the storage: borrowed pointers are gone, handles still resolve.
+    std::vector<SlotHandle> more;
+    for (int i = 0; i < 100; ++i) {
+        more.push_back(map.Insert(std::to_string(i)));
+    }
+    REQUIRE(*map.Get(first) == "first");
+
+    // Moves the last object into the hole.
+    map.Erase(first);
+    REQUIRE(map.Get(first) == nullptr);
+    REQUIRE(*map.Get(second) == "second");
+    REQUIRE(*map.Get(more.back()) == "99");
+}
+
+TEST_CASE("SlotMap random operations") {
+    SlotMap<int> map;
+    std::unordered_map<uint64_t, int> expected;
+    std::vector<SlotHandle> erased;
+    std::mt19937 rng(42);
+    for (int i = 0; i < 10000; ++i) {
+        if (expected.empty() || rng() % 3 != 0) {
+            auto handle = map.Insert(i);
+            expected[handle.ToBits()] = i;
+        } else {
+            auto it = expected.begin();
+            std::advance(it, rng() % expected.size());
+            auto handle = SlotHandle::FromBits(it->first);
+            REQUIRE(map.Erase(handle));
+            erased.push_back(handle);
+            expected.erase(it);
+        }
+    }
+    REQUIRE(map.Size() == expected.size());
+    for (const auto& [bits, value] : expected) {
+        REQUIRE(*map.Get(SlotHandle::FromBits(bits)) == value);
+    }
+    for (auto handle : erased) {
+        REQUIRE(!map.Contains(handle));
+    }
+}
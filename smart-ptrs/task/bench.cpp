@@ -0,0 +1,86 @@
+#include "task.h"
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <iostream>
+#include <memory>
+
+// Millions of short tasks: Task<int> against a coroutine whose handle is owned by
+// std::shared_ptr (frame from the global heap plus a separate control block).
+// Run with `test_task [.bench]`.
+
+namespace {
+
+struct SharedTask {
+    struct promise_type {
+        SharedTask get_return_object() {
+            auto handle = std::coroutine_handle<promise_type>::from_promise(*this);
+            return {std::shared_ptr<promise_type>(this, [handle](auto) { handle.destroy(); })};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_value(int result) {
+            value = result;
+        }
+        void unhandled_exception() {
+            std::terminate();
+        }
+
+        int value = 0;
+    };
+
+    int Get() const {
+        return promise->value;
+    }
+
+    std::shared_ptr<promise_type> promise;
+};
+
+SharedTask SharedLeaf(int value) {
+    co_return value;
+}
+
+SharedTask SharedParent(int value) {
+    auto copy = SharedLeaf(value);
+    co_return copy.Get() + 1;
+}
+
+Task<int> Leaf(int value) {
+    co_return value;
+}
+
+Task<int> Parent(int value) {
+    auto copy = Leaf(value);
+    co_return co_await copy + 1;
+}
+
+constexpr int kTasks = 1 << 21;
+
+template <typename Fn>
+double MeasureNs(Fn run) {
+    int64_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < kTasks; ++i) {
+        sum += run(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    volatile int64_t sink = sum;
+    (void)sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kTasks;
+}
+
+}  // namespace
+
+TEST_CASE("Task vs shared_ptr<coroutine>", "[.bench]") {
+    double task_ns = MeasureNs([](int i) { return Parent(i).Get(); });
+    double shared_ns = MeasureNs([](int i) { return SharedParent(i).Get(); });
+
+    std::cout << "Task<int>:\t\t\t" << task_ns << " ns per 2 tasks\n"
+              << "shared_ptr<coroutine>:\t\t" << shared_ns << " ns per 2 tasks\n";
+}
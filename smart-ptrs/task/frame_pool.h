@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Size-class pool for coroutine frames.
+//
+// Frame sizes are rounded up to a multiple of kClassStep. Every thread keeps a free
+// list per class: a frame is taken from the list of the allocating thread and returned
+// to the list of the freeing thread, both without locks or atomics. A list holds at
+// most kMaxCached frames, the rest go back to ::operator delete. Frames larger than
+// kMaxFrameSize are not pooled. Once the cache of a thread is destroyed at thread exit,
+// frames allocated or freed later by its thread_local destructors bypass the pool.
+class FramePool {
+public:
+    static constexpr size_t kClassStep = 64;
+    static constexpr size_t kMaxFrameSize = 1024;
+    static constexpr size_t kMaxCached = 256;
+
+    static void* Allocate(size_t size) {
+        if (size > kMaxFrameSize) {
+            return ::operator new(size);
+        }
+        if (cache_destroyed_) {
+            return ::operator new(ClassSize(size));
+        }
+        FreeList& list = LocalCache().lists[ClassIndex(size)];
+        if (!list.head) {
+            return ::operator new(ClassSize(size));
+        }
+        Node* node = list.head;
+        list.head = node->next;
+        --list.size;
+        return node;
+    }
+
+    static void Deallocate(void* frame, size_t size) {
+        if (size > kMaxFrameSize || cache_destroyed_) {
+            ::operator delete(frame);
+            return;
+        }
+        FreeList& list = LocalCache().lists[ClassIndex(size)];
+        if (list.size == kMaxCached) {
+            ::operator delete(frame);
+            return;
+        }
+        list.head = new (frame) Node{list.head};
+        ++list.size;
+    }
+
+    // Frames cached by the calling thread.
+    static size_t NumCached() {
+        if (cache_destroyed_) {
+            return 0;
+        }
+        size_t total = 0;
+        for (const FreeList& list : LocalCache().lists) {
+            total += list.size;
+        }
+        return total;
+    }
+
+private:
+    static constexpr size_t kNumClasses = kMaxFrameSize / kClassStep;
+
+    struct Node {
+        Node* next;
+    };
+
+    struct FreeList {
+        Node* head = nullptr;
+        size_t size = 0;
+    };
+
+    struct Cache {
+        ~Cache() {
+            cache_destroyed_ = true;
+            for (FreeList& list : lists) {
+                while (list.head) {
+                    ::operator delete(std::exchange(list.head, list.head->next));
+                }
+            }
+        }
+
+        FreeList lists[kNumClasses];
+    };
+
+    // Trivially destructible, so it outlives the cache until the thread is gone.
+    static inline thread_local bool cache_destroyed_ = false;
+
+    static Cache& LocalCache() {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    static size_t ClassIndex(size_t size) {
+        return (size + kClassStep - 1) / kClassStep - 1;
+    }
+    static size_t ClassSize(size_t size) {
+        return (ClassIndex(size) + 1) * kClassStep;
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "frame_pool.h"
+
+#include <async/waiters.h>
+#include <intrusive/intrusive.h>
+
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <utility>
+
+// Coroutine task whose frame is reference counted:
+//
+//     Task<int> Parse(std::string text) { ... co_return value; }
+//     Task<int> task = Parse(text);
+//     int value = co_await task;
+//
+// The counter lives in the promise (RefCounted), and Task<T> is an intrusive pointer to
+// it: copies of a task share one frame without a separate control block, and the frame
+// is destroyed with the last copy. The running coroutine holds a reference of its own
+// until it finishes, so a task runs to completion even if every handle is dropped.
+//
+// A task starts right away. Any number of coroutines may await it; they are resumed
+// in the thread that finishes the task. Frames come from FramePool.
+
+template <typename T>
+class Task;
+
+// Destroys the frame of a promise (see RefCounted).
+struct FrameDelete {
+    template <typename Promise>
+    static void Destroy(Promise* promise) {
+        std::coroutine_handle<Promise>::from_promise(*promise).destroy();
+    }
+};
+
+template <typename Promise>
+class TaskPromiseBase : public RefCounted<Promise, AtomicCounter, FrameDelete> {
+public:
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+            auto& promise = handle.promise();
+            // Nobody else holds the task, so nobody can await it.
+            if (promise.RefCount() > 1) {
+                promise.waiters_.Close();
+            }
+            // May destroy the frame: the coroutine is already suspended.
+            promise.Release();
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    static void* operator new(size_t size) {
+        return FramePool::Allocate(size);
+    }
+    static void operator delete(void* frame, size_t size) {
+        FramePool::Deallocate(frame, size);
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+    void unhandled_exception() {
+        exception_ = std::current_exception();
+    }
+
+    bool IsDone() const {
+        return waiters_.IsClosed();
+    }
+
+    // Returns false if the task is already finished and `waiter` must not suspend.
+    bool AddWaiter(WaiterList::Waiter* waiter) {
+        return waiters_.Add(waiter);
+    }
+
+    void Wait() const {
+        waiters_.Wait();
+    }
+
+    // DecRef() for the last reference without an atomic write: references are copied
+    // only from other references, so a count of one cannot grow.
+    void Release() {
+        if (this->RefCount() == 1) {
+            FrameDelete::Destroy(static_cast<Promise*>(this));
+        } else {
+            this->DecRef();
+        }
+    }
+
+protected:
+    void RethrowIfFailed() const {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+private:
+    WaiterList waiters_;
+    std::exception_ptr exception_;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase<TaskPromise<T>> {
+public:
+    ~TaskPromise() {
+        if (has_value_) {
+            Value()->~T();
+        }
+    }
+
+    Task<T> get_return_object() {
+        return Task<T>(this);
+    }
+
+    template <typename U>
+    void return_value(U&& value) {
+        new (&buffer_) T(std::forward<U>(value));
+        has_value_ = true;
+    }
+
+    const T& Result() const {
+        this->RethrowIfFailed();
+        return *Value();
+    }
+
+private:
+    const T* Value() const {
+        return std::launder(reinterpret_cast<const T*>(&buffer_));
+    }
+    T* Value() {
+        return std::launder(reinterpret_cast<T*>(&buffer_));
+    }
+
+    bool has_value_ = false;
+    alignas(T) char buffer_[sizeof(T)];
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase<TaskPromise<void>> {
+public:
+    Task<void> get_return_object();
+
+    void return_void() {
+    }
+
+    void Result() const {
+        this->RethrowIfFailed();
+    }
+};
+
+template <typename T>
+class Task {
+    friend class TaskPromise<T>;
+
+public:
+    using promise_type = TaskPromise<T>;
+
+    class Awaiter : WaiterList::Waiter {
+    public:
+        explicit Awaiter(promise_type* promise) : promise_(promise) {
+        }
+
+        bool await_ready() const {
+            return promise_->IsDone();
+        }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            return promise_->AddWaiter(this);
+        }
+        // Rethrows the exception of the task. The result lives in the frame: it is valid
+        // while some Task refers to it.
+        decltype(auto) await_resume() const {
+            return promise_->Result();
+        }
+
+    private:
+        promise_type* promise_;
+    };
+
+    Task() {
+    }
+
+    Task(const Task& other) : promise_(other.promise_) {
+        if (promise_) {
+            promise_->IncRef();
+        }
+    }
+    Task(Task&& other) : promise_(std::exchange(other.promise_, nullptr)) {
+    }
+
+    Task& operator=(Task other) {
+        std::swap(promise_, other.promise_);
+        return *this;
+    }
+
+    ~Task() {
+        if (promise_) {
+            promise_->Release();
+        }
+    }
+
+    bool IsReady() const {
+        return promise_->IsDone();
+    }
+
+    // Blocks the calling thread until the task is finished.
+    decltype(auto) Get() const {
+        promise_->Wait();
+        return promise_->Result();
+    }
+
+    Awaiter operator co_await() const {
+        return Awaiter(promise_);
+    }
+
+    size_t UseCount() const {
+        return promise_ ? promise_->RefCount() : 0;
+    }
+    explicit operator bool() const {
+        return promise_ != nullptr;
+    }
+
+private:
+    // A new task: one reference for the handle, one for the running coroutine.
+    explicit Task(promise_type* promise) : promise_(promise) {
+        promise_->IncRef(2);
+    }
+
+    promise_type* promise_ = nullptr;
+};
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(this);
+}
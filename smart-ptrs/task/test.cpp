@@ -0,0 +1,172 @@
+#include "task.h"
+#include "allocations_checker.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Coroutines suspended on it are resumed by Fire().
+struct Event {
+    bool await_ready() const {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+        handles.push_back(handle);
+    }
+    void await_resume() const {
+    }
+
+    void Fire() {
+        while (!handles.empty()) {
+            auto handle = handles.front();
+            handles.pop_front();
+            handle.resume();
+        }
+    }
+
+    std::deque<std::coroutine_handle<>> handles;
+};
+
+struct Tracked {
+    explicit Tracked(int value) : value(value) {
+        ++alive;
+    }
+    Tracked(const Tracked& other) : value(other.value) {
+        ++alive;
+    }
+    ~Tracked() {
+        --alive;
+    }
+
+    int value;
+
+    static inline int alive = 0;
+};
+
+Task<int> Ready(int value) {
+    co_return value;
+}
+
+Task<int> Delayed(Event& event, int value) {
+    co_await event;
+    co_return value;
+}
+
+Task<Tracked> MakeTracked(Event& event, int value) {
+    co_await event;
+    co_return Tracked(value);
+}
+
+Task<int> Sum(Task<int> a, Task<int> b) {
+    co_return co_await a + co_await b;
+}
+
+Task<void> Append(Event& event, std::vector<int>* log, int value) {
+    co_await event;
+    log->push_back(value);
+}
+
+Task<int> Fail(Event& event) {
+    co_await event;
+    throw std::runtime_error("task failed");
+}
+
+Task<std::string> Observe(Task<int> task) {
+    try {
+        co_return std::to_string(co_await task);
+    } catch (const std::exception& error) {
+        co_return error.what();
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Task ready") {
+    auto task = Ready(42);
+    REQUIRE(task.IsReady());
+    REQUIRE(task.Get() == 42);
+    REQUIRE(task.UseCount() == 1);
+}
+
+TEST_CASE("Task awaits") {
+    Event event;
+    auto sum = Sum(Delayed(event, 1), Ready(2));
+    REQUIRE(!sum.IsReady());
+    event.Fire();
+    REQUIRE(sum.IsReady());
+    REQUIRE(sum.Get() == 3);
+}
+
+TEST_CASE("Task shared by many observers") {
+    Event event;
+    auto task = Delayed(event, 7);
+    auto copy = task;
+    REQUIRE(task.UseCount() == 3);
+
+    std::vector<Task<std::string>> observers;
+    for (int i = 0; i < 4; ++i) {
+        observers.push_back(Observe(task));
+    }
+    event.Fire();
+    for (auto& observer : observers) {
+        REQUIRE(observer.Get() == "7");
+    }
+    REQUIRE(copy.UseCount() == 2 + observers.size());
+}
+
+TEST_CASE("Task frame lifetime") {
+    Tracked::alive = 0;
+    Event event;
+    {
+        auto task = MakeTracked(event, 5);
+        event.Fire();
+        REQUIRE(task.Get().value == 5);
+        REQUIRE(Tracked::alive == 1);
+    }
+    REQUIRE(Tracked::alive == 0);
+
+    // All handles dropped while the task is suspended: it still runs to the end.
+    std::vector<int> log;
+    Append(event, &log, 1);
+    event.Fire();
+    REQUIRE(log == std::vector<int>{1});
+}
+
+TEST_CASE("Task exception") {
+    Event event;
+    auto task = Fail(event);
+    auto observer = Observe(task);
+    event.Fire();
+    REQUIRE_THROWS_AS(task.Get(), std::runtime_error);
+    REQUIRE(observer.Get() == "task failed");
+}
+
+TEST_CASE("Task frames are pooled") {
+    // Warm up the pool of this thread.
+    Ready(0);
+    EXPECT_ZERO_ALLOCATIONS(for (int i = 0; i < 1000; ++i) { REQUIRE(Ready(i).Get() == i); });
+    REQUIRE(FramePool::NumCached() > 0);
+}
+
+TEST_CASE("Task freed after the frame pool of its thread") {
+    struct Holder {
+        Task<int> task;
+    };
+    std::thread thread([] {
+        // Constructed before the pool cache, so destroyed after it.
+        thread_local Holder holder;
+        holder.task = Ready(1);
+        REQUIRE(FramePool::NumCached() == 0);
+    });
+    thread.join();
+}
@@ -0,0 +1,150 @@
+#include "shared.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// False sharing of control blocks: every thread copies its own hot object, and the
+// objects are allocated one after another, so compact blocks end up on common cache
+// lines. In the second scenario threads copy one pointer while a writer updates the
+// object data next to the counters. Run with `test_weak [bench]`.
+
+namespace {
+
+struct Counter {
+    std::atomic<int64_t> value = 0;
+};
+
+constexpr int kCopiesPerThread = 1 << 22;
+
+template <typename Layout>
+double NeighborsMops(int threads) {
+    std::vector<SharedPtr<Counter>> hot;
+    for (int i = 0; i < threads; ++i) {
+        hot.push_back(MakeShared<Counter, Layout>());
+    }
+    std::atomic<bool> start = false;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            while (!start.load()) {
+            }
+            for (int j = 0; j < kCopiesPerThread; ++j) {
+                SharedPtr<Counter> copy = hot[i];
+            }
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return threads * static_cast<double>(kCopiesPerThread) / seconds / 1e6;
+}
+
+template <typename Layout>
+double WriterMops(int threads) {
+    auto shared = MakeShared<Counter, Layout>();
+    std::atomic<bool> start = false;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < threads; ++i) {
+        readers.emplace_back([&] {
+            while (!start.load()) {
+            }
+            for (int j = 0; j < kCopiesPerThread; ++j) {
+                SharedPtr<Counter> copy = shared;
+            }
+        });
+    }
+    std::thread writer([&] {
+        while (!done.load(std::memory_order_relaxed)) {
+            shared->value.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    done = true;
+    writer.join();
+    return threads * static_cast<double>(kCopiesPerThread) / seconds / 1e6;
+}
+
+}  // namespace
+
+TEST_CASE("Control block false sharing", "[.bench]") {
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "threads\tneighbors: compact\tpadded64\tpadded128"
+              << "\twriter: compact\tpadded64  (Mcopies/s)\n";
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::cout << threads << '\t' << NeighborsMops<CompactLayout>(threads) << "\t\t"
+                  << NeighborsMops<CacheLinePadded<64>>(threads) << "\t\t"
+                  << NeighborsMops<CacheLinePadded<128>>(threads) << "\t\t"
+                  << WriterMops<CompactLayout>(threads) << "\t\t"
+                  << WriterMops<CacheLinePadded<64>>(threads) << '\n';
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Row {
+    int64_t id = 0;
+    int64_t value = 0;
+};
+
+constexpr int kRows = 4096;
+constexpr int kBatches = 256;
+
+template <typename Make>
+void RunRows(const char* name, Make make) {
+    double create = 0;
+    double walk = 0;
+    int64_t sum = 0;
+    for (int batch = 0; batch < kBatches; ++batch) {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<SharedPtr<Row>> rows = make();
+        create += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        // Hand every row out and back: counter traffic only.
+        begin = std::chrono::steady_clock::now();
+        for (const auto& row : rows) {
+            SharedPtr<Row> copy = row;
+            sum += copy->id;
+        }
+        walk += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        rows.clear();
+        create += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+    std::cout << name << "\tcreate+destroy " << kRows * kBatches / create / 1e6
+              << " Mrows/s\tcopy walk " << kRows * kBatches / walk / 1e6 << " Mrows/s\t(" << sum
+              << ")\n";
+}
+
+}  // namespace
+
+TEST_CASE("Batch of rows", "[.bench]") {
+    RunRows("MakeShared x n", [] {
+        std::vector<SharedPtr<Row>> rows;
+        rows.reserve(kRows);
+        for (int i = 0; i < kRows; ++i) {
+            rows.push_back(MakeShared<Row>());
+        }
+        return rows;
+    });
+    RunRows("MakeSharedBatch", [] { return MakeSharedBatch<Row>(kRows); });
+}
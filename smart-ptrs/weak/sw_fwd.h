@@ -1,11 +1,3 @@
 #pragma once
 
-#include <exception>
-
-class BadWeakPtr : public std::exception {};
-
-template <typename T>
-class SharedPtr;
-
-template <typename T>
-class WeakPtr;
+#include <core/sw_fwd.h>
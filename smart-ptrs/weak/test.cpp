@@ -163,3 +163,102 @@ TEST_CASE("Lifetimes") {
         delete wp;
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Immortal") {
+    static ImmortalShared<std::string> empty("immortal");
+
+    SharedPtr<std::string> a = empty.Get();
+    size_t count = a.UseCount();
+    WeakPtr<std::string> weak(a);
+    {
+        SharedPtr<std::string> b = a;
+        WeakPtr<std::string> weak_copy = weak;
+        REQUIRE(b.UseCount() == count);
+    }
+    a.Reset();
+    REQUIRE(!weak.Expired());
+    REQUIRE(*weak.Lock() == "immortal");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Cache-line padded MakeShared") {
+    using Compact = ControlBlockMakeShared<int>;
+    using Padded = ControlBlockMakeShared<int, ReclaimNow, CacheLinePadded<>>;
+    using Padded128 = ControlBlockMakeShared<int, ReclaimNow, CacheLinePadded<128>>;
+    STATIC_REQUIRE(sizeof(Compact) < 64);
+    STATIC_REQUIRE(alignof(Padded) == 64);
+    STATIC_REQUIRE(sizeof(Padded) == 128);
+    STATIC_REQUIRE(sizeof(Padded128) == 256);
+
+    auto ptr = MakeShared<std::string, CacheLinePadded<>>("padded");
+    REQUIRE(*ptr == "padded");
+    REQUIRE(reinterpret_cast<uintptr_t>(ptr.Get()) % 64 == 0);
+
+    WeakPtr<std::string> weak(ptr);
+    auto copy = weak.Lock();
+    REQUIRE(copy.UseCount() == 2);
+    ptr.Reset();
+    copy.Reset();
+    REQUIRE(weak.Expired());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("MakeSharedBatch") {
+    auto batch = MakeSharedBatch<MyInt>(100, 42);
+    REQUIRE(batch.size() == 100);
+    REQUIRE(MyInt::AliveCount() == 100);
+    for (size_t i = 1; i < batch.size(); ++i) {
+        REQUIRE(batch[i].Get() == batch[i - 1].Get() + 1);
+    }
+
+    // Objects die one by one.
+    WeakPtr<MyInt> weak(batch[5]);
+    auto copy = batch[7];
+    REQUIRE(copy.UseCount() == 2);
+    batch[5].Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(MyInt::AliveCount() == 99);
+
+    batch.clear();
+    REQUIRE(MyInt::AliveCount() == 1);
+    REQUIRE(*copy == 42);
+    copy.Reset();
+    REQUIRE(MyInt::AliveCount() == 0);
+    // The allocation outlives the objects while a WeakPtr holds a block.
+    REQUIRE(!weak.Lock());
+}
+
+TEST_CASE("MakeSharedBatch arguments") {
+    REQUIRE(MakeSharedBatch<int>(0).empty());
+
+    auto strings = MakeSharedBatch<std::string>(3, 5, 'x');
+    for (const auto& string : strings) {
+        REQUIRE(*string == "xxxxx");
+    }
+
+    struct alignas(64) Wide {
+        char data[10];
+    };
+    auto wide = MakeSharedBatch<Wide>(4);
+    for (const auto& ptr : wide) {
+        REQUIRE(reinterpret_cast<uintptr_t>(ptr.Get()) % 64 == 0);
+    }
+}
+
+TEST_CASE("MakeSharedBatch exception safety") {
+    struct Throwing : MyInt {
+        explicit Throwing(int* constructed) {
+            if (++*constructed == 3) {
+                throw std::runtime_error("third");
+            }
+        }
+    };
+    int constructed = 0;
+    REQUIRE_THROWS_AS(MakeSharedBatch<Throwing>(5, &constructed), std::runtime_error);
+    REQUIRE(constructed == 3);
+    REQUIRE(MyInt::AliveCount() == 0);
+}